@@ -6,6 +6,7 @@
 #include <sstream>
 #include <string>
 #include <cstring>
+#include <cctype>
 
 #include "../include/Param.h"
 
@@ -3,6 +3,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <chrono>
 #include <boost/numeric/ublas/io.hpp>
 
 #include "../include/TriMesh.h"
@@ -13,5 +16,10 @@
 
 TriMesh ConstructCurveMesh(TriMesh& mesh, TriMesh& curved_mesh, double (*pBumpFunction)(double), string boundary_name, int p);
 
+// The curved mesh of order p of a .gri file. With use_cache, it is loaded from the binary cache
+// <gri_filename>.q<p>.bin if that was written from the same .gri contents and p, otherwise it is
+// built from the .gri and the cache is (re)written. curved_mesh.SetupTime lists the steps taken.
+void LoadCurvedMesh(string gri_filename, TriMesh& curved_mesh, double (*pBumpFunction)(double), string boundary_name, int p, bool use_cache);
+
 
 #endif
\ No newline at end of file
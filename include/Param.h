@@ -1,5 +1,9 @@
 #ifndef PARAM_H
 #define PARAM_H
+
+#include <string>
+#include <vector>
+
 // Simulation Parameter is stored in a Struct
 typedef struct Param{
     double cfl;
@@ -13,13 +17,22 @@ typedef struct Param{
     double h;
     int dnOutput;
     int MAXITER;
-    std::string bound0;
-    std::string bound1;
-    std::string bound2;
-    std::string bound3;
+    std::vector<std::string> bound; // boundary condition of each boundary group, from bound0, bound1, ...
     std::string mesh_file;
     int order;
     int order_geo;
+    int num_threads;
+    std::string face_assembly;
+    std::string metric_storage;
+    std::string volume_integration; // quadrature, or nodal for the quadrature-free path on linear elements
+    std::string residual_norm;      // every: convergence norm on every step, output: every dnOutput steps only
+    std::string time_integrator;    // tvdrk3, or ssprk2 for the low-storage SSPRK(rk_stages,2)
+    int rk_stages;
+    int quad_order_linear;  // quadrature orders of linear elements, curved elements and edges, 0 chooses from p and q
+    int quad_order_curved;
+    int quad_order_face;
+    std::string mesh_cache;         // on: load the curved mesh from the binary cache next to mesh_file, see LoadCurvedMesh
+    std::string mesh_ordering;      // none, rcm, morton or hilbert: element renumbering for locality, see ordering::ReorderMesh
 } Param;
 
 #endif
@@ -7,31 +7,63 @@
 #include <boost/qvm/mat_operations.hpp>
 #include <boost/multi_array.hpp>
 
+#include "../include/euler.h"
+
+namespace ublas = boost::numeric::ublas;
+
+namespace kernels { struct KernelSet; }
+
 typedef boost::multi_array<double, 4> arr_4d;
 typedef boost::multi_array<double, 3> arr_3d;
 typedef boost::multi_array<double, 2> arr_2d;
 
+// Solution and geometry basis functions tabulated on one 2D quadrature rule
+typedef struct QuadRule2D{
+	int order;
+	int n_quad;
+	ublas::vector<double> x_quad;
+	ublas::vector<double> w_quad;
+	arr_2d Phi;
+	arr_2d Phi_Curved;
+	arr_3d GPhi;
+	arr_3d GPhi_Curved;
+	arr_2d GPhi_T; // GPhi transposed to (Np x 2 n_quad), used by the volume kernel
+} QuadRule2D;
+
 typedef struct ResData{
+	int quad_order_1d;
 	int n_quad_1d;
-	int n_quad_2d;
 	int Np;
 	int Nq;
 	ublas::vector<double> x_quad_1d;
 	ublas::vector<double> w_quad_1d;
-	ublas::vector<double> x_quad_2d;
-	ublas::vector<double> w_quad_2d;
-	arr_2d Phi;
-	arr_2d Phi_Curved;
-	arr_3d GPhi;
-	arr_3d GPhi_Curved;
+	// Element rules, chosen from p and q by solver::CalcResData
+	QuadRule2D quad_linear;                       // rule of the linear elements
+	QuadRule2D quad_curved;                       // rule of the curved elements
+	arr_2d Stiff_T;                               // reference stiffness of the nodal volume path, (Np x 2 Np), [i][2 j + d] = int dphi_i/dxi_d phi_j
 	arr_3d Phi_1D;
+	arr_3d Phi_1D_Reversed; // Phi_1D[iloc][n_quad_1d - 1 - ig], the trace seen from the right element
 	arr_3d Phi_1D_Curved;
 	arr_4d GPhi_1D;
 	arr_4d GPhi_1D_Curved;
-	ublas::matrix<ublas::matrix<double> > jacobian_in_curved_elements;
-	ublas::matrix<ublas::matrix<double> > invjacobian_in_curved_elements;
-	ublas::vector<ublas::matrix<double> > jacobian_in_linear_elements;
-	ublas::vector<ublas::matrix<double> > invjacobian_in_linear_elements;
+	std::vector<int> curved_element_ordinal;      // position of every element in mesh.CurvedElementIndex, -1 for linear elements
+	std::vector<unsigned char> element_num_face;  // interior and boundary edges of every element, see kernels::ElementFinish
+	std::vector<double> jacobian_linear;          // J of the linear elements, ielem * 4 + 2 a + b
+	std::vector<double> jacobian_curved;          // J of the curved elements on quad_curved, (icurved * n_quad + ig) * 4 + 2 a + b,
+	                                              // released after the mass matrices with the compact metric policy
+	// Metric terms of the volume integral, adj(J) w = invJ detJ w, see solver::CalcMetricCache
+	bool metric_compact;                          // curved metrics are recomputed by the volume kernel
+	std::vector<double> metric;                   // linear elements, full: (ielem * n_quad + ig) * 4 + 2 d + c, compact: adj(J), ielem * 4 + 2 d + c
+	std::vector<double> metric_curved;            // full: curved elements, (icurved * n_quad + ig) * 4 + 2 d + c
+	std::vector<double> curved_element_nodes;     // compact: geometry nodes of the curved elements, (icurved * Nq + iq) * 2 + d
+	// Geometry of the curved boundary edges on the 1D quadrature points, point index icurved * n_quad_1d + ig
+	// with icurved the position of the edge in mesh.CurvedEdgeIndex
+	std::vector<int> curved_edge_ordinal;         // icurved of every boundary edge, -1 for linear edges
+	std::vector<double> curved_edge_normal;       // unit normals, (x, y) per point
+	std::vector<double> curved_edge_jacobian;     // surface jacobians
+	std::vector<double> curved_edge_x;            // x coordinates for the pressure distribution
+	std::vector<euler::BoundaryCondition> boundary_conditions; // one per boundary group, see solver::CalcBoundaryConditions
+	const kernels::KernelSet* kernel_set; // residual kernels specialized on (p, q), see kernels::SelectKernelSet
 } ResData;
 
 #endif
\ No newline at end of file
@@ -6,13 +6,98 @@
 #include <sstream>
 #include <string>
 #include <vector>
+#include <array>
+#include <utility>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <algorithm>
-#include <boost/numeric/ublas/matrix_sparse.hpp>
 
 #include "../include/utils.h"
 
 using namespace std;
 
+// Flat mesh topology. The structures below are the storage of the TriMesh members E, V, I2E, In, B2E and Bn:
+// offset-indexed or structure of arrays with 0-based 32-bit indices, streamed by the kernels. Legacy callers
+// keep the former row syntax through read-only views, e.g. mesh.I2E[iedge][0] is still the 1-based left element.
+
+// Read-only row of a legacy view, row[j] = owner.Get(i, j)
+template <typename Owner, typename T>
+class LegacyRow
+{
+  public:
+    LegacyRow(const Owner& owner, int i) : owner(owner), i(i) {}
+    T operator[](int j) const { return owner.Get(i, j); }
+    size_t size() const { return owner.RowSize(i); }
+  private:
+    const Owner& owner;
+    int i;
+};
+
+// Element nodes, the 0-based nodes of element ielem are node[offset[ielem]] ... node[offset[ielem + 1] - 1],
+// legacy row [node + 1, ...] with the number of nodes of the element
+struct ElementNodes
+{
+    vector<int> offset, node;
+    size_t size() const { return offset.empty() ? 0 : offset.size() - 1; }
+    void Assign(const vector<vector<int> >& rows); // from 1-based rows
+    bool operator==(const ElementNodes& other) const { return offset == other.offset && node == other.node; }
+    size_t RowSize(int i) const { return offset[i + 1] - offset[i]; }
+    int Get(int i, int j) const { return node[offset[i] + j] + 1; }
+    LegacyRow<ElementNodes, int> operator[](int i) const { return LegacyRow<ElementNodes, int>(*this, i); }
+};
+
+// Node coordinates, legacy row [x, y]
+struct NodeCoordinates
+{
+    vector<double> x, y;
+    size_t size() const { return x.size(); }
+    void resize(size_t n) { x.resize(n); y.resize(n); }
+    void push_back(const vector<double>& point) { x.push_back(point[0]); y.push_back(point[1]); }
+    bool operator==(const NodeCoordinates& other) const { return x == other.x && y == other.y; }
+    size_t RowSize(int) const { return 2; }
+    double Get(int i, int j) const { return j == 0 ? x[i] : y[i]; }
+    LegacyRow<NodeCoordinates, double> operator[](int i) const { return LegacyRow<NodeCoordinates, double>(*this, i); }
+};
+
+// Interior faces, the left element being the one with the lower index, legacy row [elemL + 1, locL + 1, elemR + 1, locR + 1]
+struct InteriorFaces
+{
+    vector<int> elemL, locL, elemR, locR;
+    size_t size() const { return elemL.size(); }
+    void resize(size_t n) { elemL.resize(n); locL.resize(n); elemR.resize(n); locR.resize(n); }
+    size_t RowSize(int) const { return 4; }
+    int Get(int i, int j) const { return 1 + (j == 0 ? elemL[i] : j == 1 ? locL[i] : j == 2 ? elemR[i] : locR[i]); }
+    LegacyRow<InteriorFaces, int> operator[](int i) const { return LegacyRow<InteriorFaces, int>(*this, i); }
+};
+
+// Boundary faces, legacy row [elemL + 1, locL + 1, group + 1]
+struct BoundaryFaces
+{
+    vector<int> elemL, locL, group;
+    size_t size() const { return elemL.size(); }
+    void resize(size_t n) { elemL.resize(n); locL.resize(n); group.resize(n); }
+    size_t RowSize(int) const { return 3; }
+    int Get(int i, int j) const { return 1 + (j == 0 ? elemL[i] : j == 1 ? locL[i] : group[i]); }
+    LegacyRow<BoundaryFaces, int> operator[](int i) const { return LegacyRow<BoundaryFaces, int>(*this, i); }
+};
+
+// Unit normals pointing out of the left element and lengths of the straight faces, legacy row [nx, ny, len],
+// for boundary faces [nx, ny, len, curved] with curved 1 on the curved boundary group
+struct FaceNormals
+{
+    vector<double> nx, ny, len;
+    vector<char> curved; // boundary faces only
+    size_t size() const { return nx.size(); }
+    size_t RowSize(int) const { return curved.empty() ? 3 : 4; }
+    double Get(int i, int j) const { return j == 0 ? nx[i] : j == 1 ? ny[i] : j == 2 ? len[i] : curved.empty() ? 0.0 : double(curved[i]); }
+    LegacyRow<FaceNormals, double> operator[](int i) const { return LegacyRow<FaceNormals, double>(*this, i); }
+};
+
 class TriMesh
 {
   public:
@@ -21,33 +106,62 @@ class TriMesh
     int num_element;
     double num_boundary;
     int curved_group;
-    vector<vector<int> > E;
-    vector<vector<double> > V;
+    ElementNodes E;
+    NodeCoordinates V;
     vector<vector<vector<int> > > B;
     vector<double> Area;
     vector<string> Bname;
     vector<string> name_base;
     vector<int> n_base;
-    vector<vector<int> > I2E;
-    vector<vector<int> > B2E;
-    vector<vector<double> > In;
-    vector<vector<double> > Bn;
+    InteriorFaces I2E;
+    vector<vector<int> > I2EClass; // interior edges grouped by (ilocL, ilocR), class = 3 * ilocL + ilocR
+    BoundaryFaces B2E;
+    FaceNormals In;
+    FaceNormals Bn;
     vector<bool> isCurved;
     vector<int> CurvedElementIndex;
     vector<int> LinearElementIndex;
     vector<int> CurvedEdgeIndex;
     vector<int> LinearEdgeIndex;
+    vector<vector<int> > B2EGroup; // boundary edges of each boundary group, curved edges first
+    vector<vector<int> > I2EColor; // interior edges of each color and class, index = 9 * color + class
+    vector<vector<int> > B2EColor; // boundary edges of each color
+    vector<pair<string, double> > SetupTime; // wall time of the construction steps, in seconds
+    vector<int> ElemOriginal; // .gri index of every element after Renumber, empty if the mesh was never renumbered
 
+    TriMesh();
     TriMesh(string &gri_filename_in);
     TriMesh(TriMesh &mesh);
+    TriMesh(TriMesh &&mesh) = default;
+    TriMesh& operator=(const TriMesh &mesh) = default;
+    TriMesh& operator=(TriMesh &&mesh) = default;
     void ReadGri(string &gri_filename);
-    void CalcI2E();
-    void CalcB2E();
+    void ReadGriStream(string &gri_filename);
+    static unsigned long long EdgeKey(int n1, int n2); // 64-bit key of the edge between 1-based nodes n1 and n2
+    void CalcHalfEdge(vector<pair<unsigned long long, int> >& half_edge);
+    void CalcI2E(const vector<pair<unsigned long long, int> >& half_edge);
+    void CalcI2EClass();
+    void CalcB2E(const vector<pair<unsigned long long, int> >& half_edge);
     void CalcIn();
     void CalcBn();
     void CalcArea();
     void FindCurvedIndex();
+    void CalcFaceColor();
+    // Renumber the elements to element_order (new index -> current index), the nodes in the order
+    // they are first met in the new elements, and rebuild the faces, normals and index lists on the
+    // new numbering, so the interior faces follow the element order
+    void Renumber(const vector<int>& element_order);
+    // Current index of every element in the order of the .gri file
+    vector<int> ElementsInFileOrder() const;
     void WriteGri(string &gri_filename);
+    // Binary mesh cache holding the mesh with all derived connectivity and normals, see TriMesh.cpp for the layout.
+    // ReadBinary loads it only if it was written from a .gri with hash source_hash and with order_geo, else returns false.
+    void WriteBinary(string &filename, unsigned long long source_hash, int order_geo);
+    bool ReadBinary(string &filename, unsigned long long source_hash, int order_geo);
+    static unsigned long long HashFile(const string &filename);
+    // Memory of the mesh arrays in bytes, or with nested_rows an estimate for E, V, I2E, B2E, In and Bn
+    // stored as vectors of row vectors, the layout before the flat topology
+    double MemoryBytes(bool nested_rows) const;
 
 };
 
@@ -6,6 +6,8 @@
 #include <cmath>
 #include <string>
 #include <cstring>
+#include <limits>
+#include <algorithm>
 
 #include <boost/numeric/ublas/matrix.hpp>
 #include <boost/numeric/ublas/vector.hpp>
@@ -18,12 +20,41 @@ namespace euler
 {
     namespace ublas = boost::numeric::ublas;
 
-    ublas::matrix<double> CalcAnalyticalFlux(ublas::vector<double> state, double gamma);
-
-    ublas::vector<double> CalcNumericalFlux(ublas::vector<double> uL, ublas::vector<double> uR, ublas::vector<double> norm,
-                                            double gamma, char* type_flux, double& mws);
-
-    ublas::vector<double> ApplyBoundaryCondition(ublas::vector<double> u, ublas::vector<double> norm, std::string boundary_type, Param& cparam, double &mws);
+    ublas::matrix<double> CalcAnalyticalFlux(const ublas::vector<double>& state, double gamma);
+    void CalcAnalyticalFlux(const double* state, double gamma, double* F);
+
+    ublas::vector<double> CalcNumericalFlux(const ublas::vector<double>& uL, const ublas::vector<double>& uR, const ublas::vector<double>& norm,
+                                            double gamma, const char* type_flux, double& mws);
+    void CalcRoeFlux(const double* uL, const double* uR, const double* norm, double gamma, double* F_hat, double& mws);
+
+    // Batched fluxes on n points stored as structure of arrays, component s of point i is U[s * ld_U + i].
+    // The analytical flux is written to F[(s * 2 + d) * ld_F + i], the Roe flux to F_hat[s * ld_F + i].
+    void CalcAnalyticalFluxBatch(int n, const double* U, int ld_U, double gamma, double* F, int ld_F);
+    void CalcRoeFluxBatch(int n, const double* UL, const double* UR, int ld_U, const double* nx, const double* ny,
+                          double gamma, double* F_hat, int ld_F, double* mws);
+
+    // Boundary condition of one boundary group, resolved from its name once at setup
+    enum BoundaryType {Inflow, Inviscid_Wall, Subsonic_Outflow, Free_Stream, num_boundary_type};
+    struct BoundaryCondition;
+    typedef void (*BoundaryKernel)(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                                   double* F, int ld_F, double* mws);
+    struct BoundaryCondition
+    {
+        BoundaryType type;
+        BoundaryKernel kernel;  // entry of the boundary kernel table for type
+        double gamma;
+        double p_b;             // static pressure of the subsonic outflow
+        double R, Tt, pt;       // gas constant, total temperature and total pressure of the inflow
+        double dir[2];          // inflow direction
+        double u_free[4];       // free stream state
+    };
+    BoundaryCondition SetupBoundaryCondition(const std::string& boundary_type, Param& param);
+
+    // Boundary flux on n points stored as structure of arrays, U[s * ld_U + i] in and F[s * ld_F + i] out
+    void ApplyBoundaryConditionBatch(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                                     double* F, int ld_F, double* mws);
+
+    ublas::vector<double> ApplyBoundaryCondition(const ublas::vector<double>& u, const ublas::vector<double>& norm, const std::string& boundary_type, Param& cparam, double &mws);
 
     ublas::vector<double> CalcFreeStreamState_2DEuler(Param& param);
 }
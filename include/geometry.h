@@ -19,12 +19,12 @@ namespace geometry
 
     double BumpFunction(double x);
 
-    ublas::matrix<double> CalcJacobianLinear(TriMesh mesh, int ielem);
-    ublas::matrix<double> CalcJacobianCurved(TriMesh mesh, int ielem, boost::multi_array<double, 3> GPhi, int n_quad_2d, int ig);
+    ublas::matrix<double> CalcJacobianLinear(const TriMesh& mesh, int ielem);
+    ublas::matrix<double> CalcJacobianCurved(const TriMesh& mesh, int ielem, const boost::multi_array<double, 3>& GPhi, int n_quad_2d, int ig);
 
     ublas::vector<int> GetEdgeLagrangeNodeIndex(int p, int local_index);
-    ublas::vector<ublas::vector<double> > GetEdgeCoordinates(TriMesh mesh, int iedge);
-    ublas::vector<int> GetEdgeCoordinatesIndex(TriMesh mesh, int iedge);
+    ublas::vector<ublas::vector<double> > GetEdgeCoordinates(const TriMesh& mesh, int iedge);
+    ublas::vector<int> GetEdgeCoordinatesIndex(const TriMesh& mesh, int iedge);
 } // namespace geometry
 
 #endif
\ No newline at end of file
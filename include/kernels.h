@@ -0,0 +1,148 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+#include <boost/multi_array.hpp>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../include/TriMesh.h"
+#include "../include/ResData.h"
+#include "../include/euler.h"
+#include "../include/geometry.h"
+#include "../include/Param.h"
+#include "../include/mass.h"
+
+namespace kernels
+{
+    namespace ublas = boost::numeric::ublas;
+
+    // Highest solution order p and geometry order q with compile-time specialized kernels,
+    // other orders fall back to the generic kernels with runtime sizes
+    const int max_order_specialized = 4;
+    const int max_order_geo_specialized = 4;
+
+    // Fixed-size state type of the specialized kernels
+    typedef std::array<double, 4> State;
+
+    // Number of elements whose states are interpolated together by one dense product
+    const int n_batch_element = 32;
+    // Number of interior edges of the same orientation class traced together
+    const int n_batch_face = 32;
+
+    // Scratch buffers of the kernels, one set per thread, sized on first use and reused afterwards
+    struct Scratch
+    {
+        std::vector<double> UL, UR;             // states on lagrange nodes
+        std::vector<double> UL_quad, UR_quad;   // states on quadrature points
+        std::vector<double> F_quad;             // weighted flux on quadrature points
+        std::vector<double> RL, RR;             // projected contributions
+        std::vector<double> mws;                // max wave speed per edge
+        std::vector<double> F_point;            // flux of one quadrature point for the whole batch
+        std::vector<double> mws_point;          // max wave speed of one quadrature point for the whole batch
+        std::vector<double> norm;               // normals of the edges in the batch, x components then y
+        std::vector<double> update;             // invM R of the element being updated
+    };
+    Scratch& GetThreadScratch();
+
+    // Dense row-major product C(m x n) = A(m x k) * B(k x n), or C += A * B if accumulate
+    void MatMul(const double* A, const double* B, double* C, int m, int k, int n, bool accumulate);
+
+    // Dense row-major product C(m x n) = A^T * B with A stored as (k x m), or C += A^T * B if accumulate
+    void MatTransMul(const double* A, const double* B, double* C, int m, int k, int n, bool accumulate);
+
+    // Volume (interior) contribution of the elements in element_index, subtracted from Residual.
+    // The states of a batch of elements are interpolated to all quadrature points of the element rule
+    // (resdata.quad_linear or quad_curved) with one (n_quad x Np) * (Np x 4 n_batch) product, the
+    // analytical flux is evaluated for the whole batch at each quadrature point, and the result is
+    // projected back with GPhi_T as a second product.
+    // The columns of the batch matrices are ordered state * n_batch + element, so every row holds
+    // the states of one quadrature point as structure of arrays for the batched flux functions.
+    // The metric terms come from resdata.metric and metric_curved, or with the compact policy are
+    // rebuilt for curved elements from their geometry nodes.
+    // Batches are distributed over the OpenMP threads, each element is written by one batch only.
+    void CalcVolumeResidual(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                            bool curved, double gamma, ublas::vector<double>& Residual);
+
+    // Quadrature-free volume contribution of the linear elements in element_index, subtracted from Residual.
+    // The flux is represented in nodal form, F_h = sum_j F(u_j) phi_j, so with the constant adj(J) of an
+    // affine element the volume integral reduces to the reference stiffness matrices in resdata.Stiff_T
+    // applied to the pulled back nodal fluxes, one (Np x 2 Np) * (2 Np x 4 n_batch) product per batch.
+    void CalcVolumeResidualNodal(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                                 double gamma, ublas::vector<double>& Residual);
+
+    // One stage of a low-storage Runge-Kutta step, States = a States_0 + b States - c dt invM Residual
+    struct StageUpdate
+    {
+        double a, b, c;
+        const mass::InvMass* inv_mass;
+        const ublas::vector<double>* dt;          // time step of the stage combination, per element
+        const ublas::vector<double>* States_0;
+        ublas::vector<double>* States;            // updated in place, may be the states the residual was evaluated on
+    };
+
+    // Completion of the element blocks inside the face sweeps, which run after the volume contributions.
+    // Every face contribution counts down faces_left of its elements (solver::CalcResData sets
+    // resdata.element_num_face), and the element is finished by the face kernel that adds its last one:
+    // the local time step dt from mws_tally and, with stage set, the inverse mass and the stage combination
+    // on the finished residual block while it is still in cache. A finished element is read by no later face.
+    // In the colored sweeps an element has at most one edge per color, so its counter is never shared by
+    // concurrent batches.
+    struct ElementFinish
+    {
+        double cfl;
+        ublas::vector<double>* dt;
+        const StageUpdate* stage;                 // may be NULL
+        std::vector<unsigned char>* faces_left;
+    };
+
+    // Interior edge contribution, added to Residual of the left and right elements and to mws_tally.
+    // Edges are processed per orientation class (mesh.I2EClass): the left and right states of a batch
+    // are interpolated onto the edge quadrature points into a contiguous trace buffer, the Roe flux is
+    // evaluated for the whole batch at each quadrature point and the weighted flux is lifted back with
+    // the class tables.
+    // With colored set, the edges are processed color by color (mesh.I2EColor) and the batches of one
+    // color run concurrently. Each element receives its edge contributions in the same order as in the
+    // serial sweep, so both modes give bit-identical results.
+    void CalcInteriorFaceResidual(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                  double gamma, bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                  const ElementFinish& finish);
+
+    // Boundary edge contribution, group by group (mesh.B2EGroup) or color by color (mesh.B2EColor).
+    // The edges of one boundary group are evaluated in batches with the boundary kernel resolved for
+    // the group in resdata.boundary_conditions.
+    void CalcBoundaryFaceResidual(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                  bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                  const ElementFinish& finish);
+
+    // The stage combination alone, for a residual carried over from the previous step
+    void ApplyStageUpdate(const ResData& resdata, const StageUpdate& stage, const ublas::vector<double>& Residual);
+
+    // The residual kernels of one (p, q) pair. CalcResData selects the set once and stores it in
+    // resdata.kernel_set, the functions above only forward to it.
+    struct KernelSet
+    {
+        int p, q;
+        bool specialized;   // false for the generic kernels
+        void (*volume)(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                       bool curved, double gamma, ublas::vector<double>& Residual);
+        void (*volume_nodal)(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                             double gamma, ublas::vector<double>& Residual);
+        void (*interior_face)(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                              double gamma, bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                              const ElementFinish& finish);
+        void (*boundary_face)(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                              bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                              const ElementFinish& finish);
+        void (*stage_update)(const ResData& resdata, const StageUpdate& stage, const ublas::vector<double>& Residual);
+    };
+    const KernelSet* SelectKernelSet(int p, int q);
+
+} // namespace kernels
+
+#endif
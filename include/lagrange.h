@@ -26,14 +26,15 @@ namespace lagrange
 
     ublas::vector<double> MapPhysicalToReferenceLinear(ublas::vector<ublas::vector<double> > vertex, ublas::vector<double> point, int p);
 
-    ublas::vector<ublas::vector<double> > MapReferenceToPhysical(TriMesh mesh,  int ielem, int p, double (*pBumpFunction)(double));
+    ublas::vector<ublas::vector<double> > MapReferenceToPhysical(const TriMesh& mesh,  int ielem, int p, double (*pBumpFunction)(double));
 
-    ublas::vector<ublas::matrix<double> > ConstructMassMatrix(int p, TriMesh mesh, ResData resdata);
-    ublas::vector<ublas::matrix<double> > CalcInvMassMatrix(ublas::vector<ublas::matrix<double> > M);
+    // Same with the local index of the curved boundary edge of the element already known, -1 for none,
+    // so callers mapping every element can find the curved edges with one pass over B2E
+    ublas::vector<ublas::vector<double> > MapReferenceToPhysical(const TriMesh& mesh,  int ielem, int p, double (*pBumpFunction)(double), int iloc_curved);
 
-    ublas::vector<double> CalcBaseFunction(ublas::matrix<double> TriLagrangeCoeff, double xi, double eta);
+    ublas::vector<double> CalcBaseFunction(const ublas::matrix<double>& TriLagrangeCoeff, double xi, double eta);
 
-    ublas::matrix<double> CalcBaseFunctionGradient(ublas::matrix<double> TriLagrangeCoeff, double xi, double eta);
+    ublas::matrix<double> CalcBaseFunctionGradient(const ublas::matrix<double>& TriLagrangeCoeff, double xi, double eta);
 
 } // namespace lagrange
 
@@ -0,0 +1,42 @@
+#ifndef MASS_H
+#define MASS_H
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <boost/numeric/ublas/matrix.hpp>
+#include <boost/numeric/ublas/vector.hpp>
+
+#include "../include/InvertMatrix.h"
+#include "../include/TriMesh.h"
+#include "../include/ResData.h"
+
+namespace mass
+{
+    namespace ublas = boost::numeric::ublas;
+
+    // Inverse mass operator of all elements.
+    // An affine element has M = detJ M_ref, so its inverse is one shared reference inverse scaled by 1 / detJ.
+    // Only the curved elements keep a matrix of their own, as the Cholesky factor of M = L L^T, indexed
+    // by resdata.curved_element_ordinal.
+    struct InvMass
+    {
+        int Np;
+        std::vector<double> inv_mass_ref;      // inverse of the reference mass matrix, (Np x Np)
+        std::vector<double> inv_det_jacobian;  // 1 / detJ of the linear elements, per element
+        std::vector<double> cholesky;          // L of the curved elements with inverted diagonal, (icurved * Np + i) * Np + j, j <= i
+    };
+
+    // Mass matrices integrated on the element rules of resdata, consistent with the residual
+    void ConstructInvMass(int p, const TriMesh& mesh, const ResData& resdata, InvMass& inv_mass);
+
+    // Y = M^-1 X for the (Np x 4) block X of one curved element, by forward and backward substitution with L.
+    // X and Y may be the same array.
+    void SolveCurved(const InvMass& inv_mass, int icurved, const double* X, double* Y);
+
+    // Memory of the operator in bytes
+    double MemoryBytes(const InvMass& inv_mass);
+
+} // namespace mass
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef ORDERING_H
+#define ORDERING_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <strings.h>
+
+#include "../include/TriMesh.h"
+
+namespace ordering
+{
+    // Element orders for cache locality, each returns new index -> current index for TriMesh::Renumber.
+    // Reverse Cuthill-McKee on the element graph of the interior faces, component by component from a
+    // pseudo-peripheral element, neighbours visited by increasing degree
+    std::vector<int> ElementOrderRCM(const TriMesh& mesh);
+    // Elements sorted along a space-filling curve through their vertex centroids, quantized to
+    // 16 bits per direction on the bounding box: Morton (Z-order) or Hilbert curve
+    std::vector<int> ElementOrderMorton(const TriMesh& mesh);
+    std::vector<int> ElementOrderHilbert(const TriMesh& mesh);
+
+    // Locality of the interior face sweep of the residual: the mean |elemL - elemR| of the interior faces,
+    // and the misses of an LRU cache of num_lines lines of line_bytes when the left and right element blocks
+    // of block_bytes are read face by face in the order of the kernels (class by class, mesh.I2EClass).
+    // One class visits an element about once, so blocks are hardly reused at cache line size within a
+    // sweep and the ordering shows at page size, where neighbouring blocks share a line.
+    double FaceBandwidth(const TriMesh& mesh);
+    long long FaceSweepMisses(const TriMesh& mesh, int block_bytes, int line_bytes, int num_lines);
+    const int page_bytes = 4096;
+    const int num_pages = 64; // about a first level data TLB
+
+    // Renumbers mesh with method none, rcm, morton or hilbert and prints the locality before and after
+    // for element blocks of block_bytes. Returns false for none.
+    bool ReorderMesh(TriMesh& mesh, const std::string& method, int block_bytes);
+
+} // namespace ordering
+
+#endif
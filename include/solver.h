@@ -20,6 +20,8 @@
 #include "../include/ConstructCurveMesh.h"
 #include "../include/Param.h"
 #include "../include/ResData.h"
+#include "../include/kernels.h"
+#include "../include/mass.h"
 
 namespace ublas = boost::numeric::ublas;
 
@@ -29,15 +31,46 @@ typedef boost::multi_array<double, 2> arr_2d;
 
 namespace solver {
 
-	ublas::vector<double> CalcResidual(TriMesh mesh, Param& param, ResData& resdata, ublas::vector<double> States, ublas::vector<double>& dtA, int p);
+	// Registers of the low-storage integrators, sized on the first step and reused afterwards
+	typedef struct RKWorkspace{
+		ublas::vector<double> States_0;   // states at the start of the step
+		ublas::vector<double> Residual;   // residual of the current stage, carried over to the next step
+		ublas::vector<double> mws_tally;
+		ublas::vector<double> dt;         // local time step of the first stage
+		ublas::vector<double> dt_stage;   // time step of the later stages, not used
+	} RKWorkspace;
 
-	void CalcResData(TriMesh mesh, int p, ResData& resdata);
+	ublas::vector<double> CalcResidual(const TriMesh& mesh, Param& param, const ResData& resdata, const ublas::vector<double>& States, ublas::vector<double>& dtA, int p);
 
-	ublas::vector<double> TimeMarching_TVDRK3(TriMesh mesh, Param& param, ResData& resdata, ublas::vector<double> States_old, ublas::vector<ublas::matrix<double> > invM, int p, int& converged, double& norm_residual);
+	// Same as above, into the preallocated Residual (size of States) and mws_tally (one per element).
+	// With stage set, the stage combination is applied to every element as soon as its residual is complete,
+	// stage->States may then be States itself.
+	void CalcResidual(const TriMesh& mesh, Param& param, const ResData& resdata, const ublas::vector<double>& States, ublas::vector<double>& dtA, int p,
+	                  ublas::vector<double>& Residual, ublas::vector<double>& mws_tally, const kernels::StageUpdate* stage = NULL);
 
-	void PostProc(TriMesh mesh, ublas::vector<double> States, int p, ublas::vector<ublas::matrix<double> >& Nodes, ublas::vector<ublas::matrix<double> >& States_on_Nodes);
+	// Tabulate the order p solution basis and the order q geometry basis on the 2D rule of order quad_order
+	void CalcQuadRule2D(int quad_order, int p, int q, QuadRule2D& rule);
 
-	void CalcScalarOutputs(TriMesh mesh, ResData resdata, ublas::vector<ublas::matrix<double> >& States_on_Nodes, ublas::vector<ublas::matrix<double> >& Nodes, Param param, double& err_entropy, double& coeff_lift, double& coeff_drag, std::vector<std::vector<double> >& p_coeff_dist);
+	void CalcResData(const TriMesh& mesh, int p, const Param& param, ResData& resdata);
+
+	void CalcBoundaryConditions(const TriMesh& mesh, Param& param, ResData& resdata);
+
+	void CalcMetricCache(const TriMesh& mesh, Param& param, ResData& resdata);
+
+	// Stage combinations (a, b, c) of one step of param.time_integrator after the first forward Euler stage,
+	// each States = a States_0 + b States - c dt invM R, and in step_length the time advanced by the step in units of dt
+	std::vector<std::array<double, 3> > StageCoefficients(const Param& param, double& step_length);
+
+	// One step of the low-storage SSP integrator param.time_integrator, tvdrk3 or the rk_stages stage
+	// ssprk2, updating States in place with the two registers States and workspace.States_0.
+	// The residual of the new states is left in workspace.Residual and starts the next step.
+	// The convergence norm is only evaluated with check_norm set.
+	void TimeMarching_SSPRK(const TriMesh& mesh, Param& param, const ResData& resdata, ublas::vector<double>& States, const mass::InvMass& inv_mass, int p,
+	                        RKWorkspace& workspace, bool check_norm, int& converged, double& norm_residual);
+
+	void PostProc(const TriMesh& mesh, const ublas::vector<double>& States, int p, ublas::vector<ublas::matrix<double> >& Nodes, ublas::vector<ublas::matrix<double> >& States_on_Nodes);
+
+	void CalcScalarOutputs(const TriMesh& mesh, const ResData& resdata, ublas::vector<ublas::matrix<double> >& States_on_Nodes, ublas::vector<ublas::matrix<double> >& Nodes, const Param& param, double& err_entropy, double& coeff_lift, double& coeff_drag, std::vector<std::vector<double> >& p_coeff_dist);
 
 
 }
@@ -18,7 +18,8 @@ namespace utils
 
     int GetFullOrderIndex(int r, int s, int order);
 
-    std::vector<int> GetVertexIndex(std::vector<int>& element);
+    std::vector<int> GetVertexIndex(const std::vector<int>& element);
+    std::vector<int> GetVertexIndex(int num_node_in_element);
 
     bool SortByColumn0(std::vector<int> const& v1, std::vector<int> const& v2);
 
@@ -0,0 +1,217 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <boost/numeric/ublas/io.hpp>
+
+#include "../include/TriMesh.h"
+#include "../include/utils.h"
+#include "../include/lagrange.h"
+#include "../include/geometry.h"
+#include "../include/ConstructCurveMesh.h"
+#include "../include/solver.h"
+#include "../include/euler.h"
+#include "../include/Param.h"
+#include "../include/Collective.h"
+#include "../include/ordering.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// Average wall time of one residual evaluation, repeated for at least min_time seconds
+double TimeResidual(const TriMesh& mesh, Param& param, const ResData& resdata, const ublas::vector<double>& States,
+                    ublas::vector<double>& dt, int p, ublas::vector<double>& Residual)
+{
+    const double min_time = 0.5;
+    Residual = solver::CalcResidual(mesh, param, resdata, States, dt, p); // warm up the per-thread scratch
+    int n_repeat = 0;
+    double elapsed = 0.0;
+    chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
+    while (n_repeat < 3 || elapsed < min_time)
+    {
+        Residual = solver::CalcResidual(mesh, param, resdata, States, dt, p);
+        n_repeat++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - time_start).count();
+    }
+    return elapsed / n_repeat;
+}
+
+// Wall time of one call of the member reader of mesh on gri_file, best of three
+double TimeMeshReader(TriMesh& mesh, void (TriMesh::*reader)(string&), string gri_file)
+{
+    double best = 0.0;
+    for (int irepeat = 0; irepeat < 3; irepeat++)
+    {
+        chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
+        (mesh.*reader)(gri_file);
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - time_start).count();
+        if (irepeat == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+// Free stream with a smooth x momentum perturbation, so the nodal flux is not trivially exact.
+// The perturbation depends on the first node of the element only, so it follows the element through a renumbering.
+ublas::vector<double> PerturbedFreeStream(const TriMesh& mesh, Param& param, int Np)
+{
+    ublas::vector<double> States (mesh.num_element * Np * 4, 0.0);
+    ublas::vector<double> u_free = euler::CalcFreeStreamState_2DEuler(param);
+    for (int ielem = 0; ielem < mesh.num_element; ielem++)
+    {
+        for (int ip = 0; ip < Np; ip++)
+        {
+            double x = mesh.V[mesh.E[ielem][0] - 1][0];
+            for (int istate = 0; istate < 4; istate++)
+            {
+                States(ielem * Np * 4 + ip * 4 + istate) = u_free(istate);
+            }
+            States(ielem * Np * 4 + ip * 4 + 1) *= 1.0 + 0.05 * sin(x + 0.1 * ip);
+        }
+    }
+    return States;
+}
+
+// Mesh ordering benchmark: simulated face sweep cache misses and residual time of every element
+// ordering against the .gri order, with the residual mapped back to the .gri order for the difference
+void BenchmarkMeshOrderings(const vector<string>& mesh_files, Param& param)
+{
+    const char* methods[] = {"none", "rcm", "morton", "hilbert"};
+    int p = param.order;
+    int q = param.order_geo;
+    int Np = int((p + 1) * (p + 2) / 2);
+    std::cout << "Mesh ordering, p = " << p << ", q = " << q << ", face sweep misses of "
+              << ordering::num_pages << " pages of " << (ordering::page_bytes >> 10) << " kB" << std::endl;
+    std::cout << setw(24) << "mesh" << setw(10) << "ordering" << setw(12) << "bandwidth" << setw(12) << "misses"
+              << setw(14) << "residual [s]" << setw(10) << "speedup" << setw(16) << "max |dR|" << std::endl;
+    param.volume_integration = "quadrature";
+    for (int imesh = 0; imesh < mesh_files.size(); imesh++)
+    {
+        string gri_file = mesh_files[imesh];
+        TriMesh mesh(gri_file);
+        string boundary_name = "bottom";
+        TriMesh curved_mesh_file_order = mesh;
+        ConstructCurveMesh(mesh, curved_mesh_file_order, geometry::BumpFunction, boundary_name, q);
+        double time_none = 0.0;
+        ublas::vector<double> Residual_none;
+        for (int imethod = 0; imethod < 4; imethod++)
+        {
+            TriMesh curved_mesh = curved_mesh_file_order;
+            if (imethod == 1)
+                curved_mesh.Renumber(ordering::ElementOrderRCM(curved_mesh));
+            else if (imethod == 2)
+                curved_mesh.Renumber(ordering::ElementOrderMorton(curved_mesh));
+            else if (imethod == 3)
+                curved_mesh.Renumber(ordering::ElementOrderHilbert(curved_mesh));
+            ublas::vector<double> States = PerturbedFreeStream(curved_mesh, param, Np);
+            ResData resdata;
+            solver::CalcResData(curved_mesh, p, param, resdata);
+            solver::CalcBoundaryConditions(curved_mesh, param, resdata);
+            solver::CalcMetricCache(curved_mesh, param, resdata);
+            ublas::vector<double> dt(curved_mesh.E.size());
+            ublas::vector<double> Residual;
+            double time_residual = TimeResidual(curved_mesh, param, resdata, States, dt, p, Residual);
+            // Residual blocks in the .gri element order
+            vector<int> element_in_file_order = curved_mesh.ElementsInFileOrder();
+            ublas::vector<double> Residual_file_order (Residual.size());
+            for (int ifile = 0; ifile < curved_mesh.num_element; ifile++)
+            {
+                int ielem = element_in_file_order[ifile];
+                for (int k = 0; k < Np * 4; k++)
+                    Residual_file_order(ifile * Np * 4 + k) = Residual(ielem * Np * 4 + k);
+            }
+            if (imethod == 0)
+            {
+                time_none = time_residual;
+                Residual_none = Residual_file_order;
+            }
+            std::cout << setw(24) << gri_file << setw(10) << methods[imethod] << setw(12) << setprecision(4)
+                      << ordering::FaceBandwidth(curved_mesh) << setw(12)
+                      << ordering::FaceSweepMisses(curved_mesh, Np * 4 * sizeof(double), ordering::page_bytes, ordering::num_pages)
+                      << setw(14) << time_residual << setw(10) << time_none / time_residual
+                      << setw(16) << ublas::norm_inf(Residual_file_order - Residual_none) << std::endl;
+        }
+    }
+}
+
+// Mesh reading benchmark of the memory-mapped ReadGri against the stream parser ReadGriStream,
+// both on the same TriMesh, whose parsed V, E, B and names must agree
+void BenchmarkMeshReaders(const vector<string>& mesh_files)
+{
+    std::cout << "Mesh reading" << std::endl;
+    std::cout << setw(24) << "mesh" << setw(10) << "elements" << setw(14) << "stream [s]"
+              << setw(12) << "mmap [s]" << setw(10) << "speedup" << setw(10) << "same" << std::endl;
+    for (int imesh = 0; imesh < mesh_files.size(); imesh++)
+    {
+        string gri_file = mesh_files[imesh];
+        TriMesh mesh(gri_file);
+        double time_stream = TimeMeshReader(mesh, &TriMesh::ReadGriStream, gri_file);
+        TriMesh mesh_stream = mesh;
+        double time_mmap = TimeMeshReader(mesh, &TriMesh::ReadGri, gri_file);
+        bool same = mesh.V == mesh_stream.V && mesh.E == mesh_stream.E && mesh.B == mesh_stream.B
+                 && mesh.Bname == mesh_stream.Bname && mesh.n_base == mesh_stream.n_base && mesh.name_base == mesh_stream.name_base;
+        std::cout << setw(24) << gri_file << setw(10) << mesh.num_element << setw(14) << setprecision(4) << time_stream
+                  << setw(12) << time_mmap << setw(10) << time_stream / time_mmap << setw(10) << (same ? "yes" : "NO") << std::endl;
+    }
+}
+
+// Mesh reading benchmark, residual benchmark of the quadrature and the quadrature-free (nodal)
+// volume path on linear elements, then the mesh ordering benchmark.
+// usage: bench.exe PARAM.in [mesh.gri ...], the meshes default to ./mesh/bump0.gri ... ./mesh/bump4.gri
+int main(int argc, char *argv[])
+{
+    namespace ublas = boost::numeric::ublas;
+
+    Param param = ReadParamIn(string(argv[1]));
+#ifdef _OPENMP
+    omp_set_num_threads(param.num_threads);
+#endif
+    vector<string> mesh_files;
+    for (int iarg = 2; iarg < argc; iarg++)
+    {
+        mesh_files.push_back(argv[iarg]);
+    }
+    if (mesh_files.empty())
+    {
+        for (int imesh = 0; imesh < 5; imesh++)
+        {
+            mesh_files.push_back("./mesh/bump" + to_string(imesh) + ".gri");
+        }
+    }
+    BenchmarkMeshReaders(mesh_files);
+    int p = param.order;
+    int q = param.order_geo;
+    int Np = int((p + 1) * (p + 2) / 2);
+    std::cout << "Residual evaluation, p = " << p << ", q = " << q << ", " << param.num_threads << " thread(s)" << std::endl;
+    std::cout << setw(24) << "mesh" << setw(10) << "elements" << setw(16) << "quadrature [s]"
+              << setw(12) << "nodal [s]" << setw(10) << "speedup" << setw(16) << "max |dR|" << std::endl;
+    for (int imesh = 0; imesh < mesh_files.size(); imesh++)
+    {
+        TriMesh mesh(mesh_files[imesh]);
+        TriMesh curved_mesh = mesh;
+        string boundary_name = "bottom";
+        ConstructCurveMesh(mesh, curved_mesh, geometry::BumpFunction, boundary_name, q);
+
+        ublas::vector<double> States = PerturbedFreeStream(curved_mesh, param, Np);
+
+        ResData resdata;
+        solver::CalcResData(curved_mesh, p, param, resdata);
+        solver::CalcBoundaryConditions(curved_mesh, param, resdata);
+        solver::CalcMetricCache(curved_mesh, param, resdata);
+        ublas::vector<double> dt(curved_mesh.E.size());
+        ublas::vector<double> Residual_quadrature, Residual_nodal;
+        param.volume_integration = "quadrature";
+        double time_quadrature = TimeResidual(curved_mesh, param, resdata, States, dt, p, Residual_quadrature);
+        param.volume_integration = "nodal";
+        double time_nodal = TimeResidual(curved_mesh, param, resdata, States, dt, p, Residual_nodal);
+        double diff = ublas::norm_inf(Residual_nodal - Residual_quadrature);
+        std::cout << setw(24) << mesh_files[imesh] << setw(10) << curved_mesh.num_element
+                  << setw(16) << setprecision(4) << time_quadrature << setw(12) << time_nodal
+                  << setw(10) << time_quadrature / time_nodal << setw(16) << diff << std::endl;
+    }
+    BenchmarkMeshOrderings(mesh_files, param);
+    return 0;
+}
@@ -10,6 +10,18 @@ Param ReadParamIn(string param_fname)
     string line, param_name, param_value;
 
 	Param param;
+	param.num_threads = 1;
+	param.face_assembly = "serial";
+	param.metric_storage = "full";
+	param.volume_integration = "quadrature";
+	param.residual_norm = "every";
+	param.time_integrator = "tvdrk3";
+	param.rk_stages = 4;
+	param.quad_order_linear = 0;
+	param.quad_order_curved = 0;
+	param.quad_order_face = 0;
+	param.mesh_cache = "off";
+	param.mesh_ordering = "none";
 	while (getline(param_file, line))
 	{
 		ss.clear();
@@ -30,18 +42,15 @@ Param ReadParamIn(string param_fname)
 		}else if (strcasecmp(param_name.c_str(), "p_inf") == 0)
 		{
 			param.p_inf = atof(param_value.c_str());
-		}else if (strcasecmp(param_name.c_str(), "bound0") == 0)
-		{
-			param.bound0 = param_value;
-		}else if (strcasecmp(param_name.c_str(), "bound1") == 0)
-		{
-			param.bound1 = param_value;
-		}else if (strcasecmp(param_name.c_str(), "bound2") == 0)
-		{
-			param.bound2 = param_value;
-		}else if (strcasecmp(param_name.c_str(), "bound3") == 0)
-		{
-			param.bound3 = param_value;
+		}else if (strncasecmp(param_name.c_str(), "bound", 5) == 0 && isdigit(param_name[5]))
+		{
+			// boundN for any number of boundary groups
+			int ibound = atoi(param_name.c_str() + 5);
+			if (param.bound.size() < ibound + 1)
+			{
+				param.bound.resize(ibound + 1);
+			}
+			param.bound[ibound] = param_value;
 		}else if (strcasecmp(param_name.c_str(), "mesh_file") == 0)
 		{
 			param.mesh_file = param_value;
@@ -67,8 +76,49 @@ Param ReadParamIn(string param_fname)
 		}else if (strcasecmp(param_name.c_str(), "order_geo") == 0)
 		{
 			param.order_geo = int(atof(param_value.c_str()));
+		}else if (strcasecmp(param_name.c_str(), "num_threads") == 0)
+		{
+			param.num_threads = int(atof(param_value.c_str()));
+		}else if (strcasecmp(param_name.c_str(), "face_assembly") == 0)
+		{
+			param.face_assembly = param_value;
+		}else if (strcasecmp(param_name.c_str(), "metric_storage") == 0)
+		{
+			param.metric_storage = param_value;
+		}else if (strcasecmp(param_name.c_str(), "volume_integration") == 0)
+		{
+			param.volume_integration = param_value;
+		}else if (strcasecmp(param_name.c_str(), "residual_norm") == 0)
+		{
+			param.residual_norm = param_value;
+		}else if (strcasecmp(param_name.c_str(), "time_integrator") == 0)
+		{
+			param.time_integrator = param_value;
+		}else if (strcasecmp(param_name.c_str(), "rk_stages") == 0)
+		{
+			param.rk_stages = int(atof(param_value.c_str()));
+		}else if (strcasecmp(param_name.c_str(), "quad_order_linear") == 0)
+		{
+			param.quad_order_linear = int(atof(param_value.c_str()));
+		}else if (strcasecmp(param_name.c_str(), "quad_order_curved") == 0)
+		{
+			param.quad_order_curved = int(atof(param_value.c_str()));
+		}else if (strcasecmp(param_name.c_str(), "quad_order_face") == 0)
+		{
+			param.quad_order_face = int(atof(param_value.c_str()));
+		}else if (strcasecmp(param_name.c_str(), "mesh_cache") == 0)
+		{
+			param.mesh_cache = param_value;
+		}else if (strcasecmp(param_name.c_str(), "mesh_ordering") == 0)
+		{
+			param.mesh_ordering = param_value;
 		}
 	}
 	param_file.close();
+	if (strcasecmp(param.time_integrator.c_str(), "ssprk2") == 0 && param.rk_stages < 2)
+	{
+		cout << "SSPRK(m,2) needs rk_stages >= 2, Aborting..." << endl;
+		abort();
+	}
 	return param;
 }
\ No newline at end of file
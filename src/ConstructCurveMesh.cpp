@@ -1,5 +1,47 @@
 #include "../include/ConstructCurveMesh.h"
 
+// Key of the hash cell (ix, iy) of side tolerance
+static unsigned long long CellKey(long long ix, long long iy)
+{
+    return (unsigned long long)(ix) * 0x9E3779B97F4A7C15ULL ^ (unsigned long long)(iy);
+}
+
+static void AddNodeToCell(double x, double y, int j, double tolerance,
+                          std::unordered_map<unsigned long long, int>& cell_last_node, std::vector<int>& node_next_in_cell)
+{
+    unsigned long long key = CellKey((long long)std::floor(x / tolerance), (long long)std::floor(y / tolerance));
+    std::unordered_map<unsigned long long, int>::iterator it = cell_last_node.find(key);
+    node_next_in_cell.push_back(it == cell_last_node.end() ? -1 : it->second);
+    cell_last_node[key] = j;
+}
+
+// Lowest index of a node of V within the tolerance of point in both coordinates, -1 if there is none.
+// Only the 3 x 3 cells around the point are searched; keys that collide only add candidates.
+static int FindNode(const NodeCoordinates& V, const std::vector<double>& point, double tolerance,
+                    const std::unordered_map<unsigned long long, int>& cell_last_node, const std::vector<int>& node_next_in_cell)
+{
+    long long ix = (long long)std::floor(point[0] / tolerance);
+    long long iy = (long long)std::floor(point[1] / tolerance);
+    int j_min = -1;
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            std::unordered_map<unsigned long long, int>::const_iterator it = cell_last_node.find(CellKey(ix + dx, iy + dy));
+            if (it == cell_last_node.end())
+                continue;
+            for (int j = it->second; j >= 0; j = node_next_in_cell[j])
+            {
+                if (std::abs(point[0] - V.x[j]) < tolerance && std::abs(point[1] - V.y[j]) < tolerance && (j_min < 0 || j < j_min))
+                {
+                    j_min = j;
+                }
+            }
+        }
+    }
+    return j_min;
+}
+
 TriMesh ConstructCurveMesh(TriMesh& mesh, TriMesh& curved_mesh, double (*pBumpFunction)(double), string boundary_name, int p)
 {
     namespace ublas = boost::numeric::ublas;
@@ -37,10 +79,23 @@ TriMesh ConstructCurveMesh(TriMesh& mesh, TriMesh& curved_mesh, double (*pBumpFu
         }
         element_counter_total++;
     }
-    std::vector<int> index_boundary_elements (num_boundary_elements);
-    for (int i = 0; i < num_boundary_elements; i++)
+    // Position in boundary_elements of every element, -1 if it is not on the boundary.
+    // An element with several edges on the boundary keeps its first one
+    std::vector<int> index_in_boundary_elements (mesh.E.size(), -1);
+    for (int i = num_boundary_elements - 1; i >= 0; i--)
+    {
+        index_in_boundary_elements[boundary_elements[i][0] - 1] = i;
+    }
+    // Spatial hash of curved_mesh.V on cells of the size of the tolerance, so a node within the
+    // tolerance lies in the same or a neighbouring cell. The nodes of a cell are chained from
+    // the last one added through node_next_in_cell.
+    const double tolerance = 1e-6;
+    std::unordered_map<unsigned long long, int> cell_last_node;
+    std::vector<int> node_next_in_cell;
+    cell_last_node.reserve(curved_mesh.V.size());
+    for (int j = 0; j < curved_mesh.V.size(); j++)
     {
-        index_boundary_elements[i] = boundary_elements[i][0] - 1;
+        AddNodeToCell(curved_mesh.V.x[j], curved_mesh.V.y[j], j, tolerance, cell_last_node, node_next_in_cell);
     }
     // The index of three vetex, which shouldn't be changed
     ublas::vector<int> index_kept(3);
@@ -48,26 +103,27 @@ TriMesh ConstructCurveMesh(TriMesh& mesh, TriMesh& curved_mesh, double (*pBumpFu
     index_kept[1] = utils::GetFullOrderIndex(p, 0, p);
     index_kept[2] = utils::GetFullOrderIndex(0, p, p);
 
+    // Element rows of curved_mesh, 1-based, rebuilt into the flat element nodes once all are curved
+    std::vector<std::vector<int> > curved_E(mesh.E.size());
     // Loop through all elements and do curve on boundary elements
     for (int i_elem = 0; i_elem < mesh.E.size(); i_elem++)
     {
-        ublas::vector<int> v_ind (3); // indices of the vertex
-        ublas::vector<ublas::vector<double> > node_lagrange, vertex(3, ublas::vector<double> (2));
-
-        for (int i = 0; i < 3; i++)
-        {
-            v_ind[i] = mesh.E[i_elem][i] - 1;
-            vertex[i][0] = mesh.V[v_ind[i]][0];
-            vertex[i][1] = mesh.V[v_ind[i]][1];
-        }
-        node_lagrange = lagrange::MapReferenceToPhysicalLinear(vertex, p);
-
         // Check if the element need to be curved
-        std::vector<int>::iterator it = std::find(index_boundary_elements.begin(), index_boundary_elements.end(), i_elem);
-        if(it != index_boundary_elements.end())
+        int index_in_boudary_elements = index_in_boundary_elements[i_elem];
+        if(index_in_boudary_elements >= 0)
         {
+            ublas::vector<int> v_ind (3); // indices of the vertex
+            ublas::vector<ublas::vector<double> > node_lagrange, vertex(3, ublas::vector<double> (2));
+
+            for (int i = 0; i < 3; i++)
+            {
+                v_ind[i] = mesh.E[i_elem][i] - 1;
+                vertex[i][0] = mesh.V[v_ind[i]][0];
+                vertex[i][1] = mesh.V[v_ind[i]][1];
+            }
+            node_lagrange = lagrange::MapReferenceToPhysicalLinear(vertex, p);
+
             // First, find which nodes in node_lagrange are on the boundary need to be curved
-            int index_in_boudary_elements = std::distance(index_boundary_elements.begin(), it);
             int local_index = boundary_elements[index_in_boudary_elements][1] - 1;
             ublas::vector<int> selected_lagrange_index = geometry::GetEdgeLagrangeNodeIndex(p, local_index);
             // modify the y coordinate using the bump function
@@ -79,11 +135,11 @@ TriMesh ConstructCurveMesh(TriMesh& mesh, TriMesh& curved_mesh, double (*pBumpFu
 
             // Now we have node_lagrange, which is the new nodes need to be written into the curved_mesh.B and we add new points
             // NOTICE: The index of 3 vertex shouldn't be changed
-            curved_mesh.E[i_elem] = std::vector<int> (int((p + 1) * (p + 2) / 2), 0);
+            curved_E[i_elem] = std::vector<int> (int((p + 1) * (p + 2) / 2), 0);
 
             for (int i_kept = 0; i_kept < 3; i_kept++)
             {
-                curved_mesh.E[i_elem][index_kept[i_kept]] = mesh.E[i_elem][i_kept];
+                curved_E[i_elem][index_kept[i_kept]] = mesh.E[i_elem][i_kept];
             }
             // add points to curved_mesh.V, !!! NOT the current vertex !!!
             for (int i = 0; i < node_lagrange.size(); i++)
@@ -91,27 +147,63 @@ TriMesh ConstructCurveMesh(TriMesh& mesh, TriMesh& curved_mesh, double (*pBumpFu
                 if ((i != index_kept[0]) && (i != index_kept[1]) && (i != index_kept[2]))
                 {
                     std::vector<double> new_point {node_lagrange[i][0], node_lagrange[i][1]};
-                    // find if the new point alreay exists
-                    int j = 0;
-                    for (j = 0; j < curved_mesh.V.size(); j++)
+                    // find if the new point alreay exists, the lowest index within the tolerance is taken
+                    int j = FindNode(curved_mesh.V, new_point, tolerance, cell_last_node, node_next_in_cell);
+                    if (j >= 0)
                     {
-                        if (std::abs(new_point[0] - curved_mesh.V[j][0]) < 1e-6 && std::abs(new_point[1] - curved_mesh.V[j][1]) < 1e-6)
-                        {
-                            curved_mesh.E[i_elem][i] = j + 1;
-                            break;
-                        }
+                        curved_E[i_elem][i] = j + 1;
                     }
-                    if (j == curved_mesh.V.size())
+                    else
                     {
                         curved_mesh.V.push_back(new_point);
-                        curved_mesh.E[i_elem][i] = curved_mesh.V.size();
+                        curved_E[i_elem][i] = curved_mesh.V.size();
+                        AddNodeToCell(new_point[0], new_point[1], curved_mesh.V.size() - 1, tolerance, cell_last_node, node_next_in_cell);
                     }
                 }
             }
         } // end of dealing with curved element
+        else
+        {
+            curved_E[i_elem].resize(mesh.E[i_elem].size());
+            for (int i = 0; i < curved_E[i_elem].size(); i++)
+            {
+                curved_E[i_elem][i] = mesh.E[i_elem][i];
+            }
+        }
     } // End loop through all elements
+    curved_mesh.E.Assign(curved_E);
     curved_mesh.curved_group = boundary_index + 1;
     curved_mesh.CalcBn();
     curved_mesh.FindCurvedIndex(); // Calculate the index of the curved elements
+    curved_mesh.CalcFaceColor(); // The boundary edge order changed with the curved edge index
     return curved_mesh;
 }
+
+void LoadCurvedMesh(string gri_filename, TriMesh& curved_mesh, double (*pBumpFunction)(double), string boundary_name, int p, bool use_cache)
+{
+    unsigned long long source_hash = 0;
+    string cache_filename = gri_filename + ".q" + to_string(p) + ".bin";
+    if (use_cache)
+    {
+        chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
+        source_hash = TriMesh::HashFile(gri_filename);
+        curved_mesh.gri_filename = gri_filename;
+        if (curved_mesh.ReadBinary(cache_filename, source_hash, p))
+        {
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now() - time_start).count();
+            curved_mesh.SetupTime.assign(1, make_pair(string("ReadBinary"), elapsed));
+            return;
+        }
+    }
+    TriMesh mesh(gri_filename);
+    curved_mesh = mesh;
+    chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
+    ConstructCurveMesh(mesh, curved_mesh, pBumpFunction, boundary_name, p);
+    curved_mesh.SetupTime.push_back(make_pair(string("ConstructCurveMesh"), chrono::duration<double>(chrono::steady_clock::now() - time_start).count()));
+    if (use_cache)
+    {
+        time_start = chrono::steady_clock::now();
+        curved_mesh.WriteBinary(cache_filename, source_hash, p);
+        curved_mesh.SetupTime.push_back(make_pair(string("WriteBinary"), chrono::duration<double>(chrono::steady_clock::now() - time_start).count()));
+    }
+}
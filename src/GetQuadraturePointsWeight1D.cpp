@@ -283,75 +283,25 @@ void GetQuadraturePointsWeight1D(int p, int &n, std::vector<double>& x, std::vec
 
 
 
-    // Output interface
-    switch (p)
+    // Output interface, the tabulated rule of the lowest order not below p.
+    // Order p = 0 is served by the one point rule.
+    const int num_rule = 20;
+    int rule_n[num_rule] = {n1, n3, n5, n7, n9, n11, n13, n15, n17, n19, n21, n23, n25, n27, n29, n31, n33, n35, n37, n39};
+    const double* rule_x[num_rule] = {x1, x3, x5, x7, x9, x11, x13, x15, x17, x19, x21, x23, x25, x27, x29, x31, x33, x35, x37, x39};
+    const double* rule_w[num_rule] = {w1, w3, w5, w7, w9, w11, w13, w15, w17, w19, w21, w23, w25, w27, w29, w31, w33, w35, w37, w39};
+    int irule = p <= 1 ? 0 : p / 2;
+    if (irule >= num_rule)
     {
-		case 0:
-		break;
-
-		case 1:
-			n = n1;
-			for (int i=0; i < n; i++)
-			{
-				x.push_back(x1[i]);
-			}
-			for (int i=0; i< n; i++)
-			{
-				w.push_back(w1[i]);
-			}
-			break;
-
-		case 3:
-			n = n3;
-			for (int i=0; i < n; i++)
-			{
-				x.push_back(x3[i]);
-			}
-			for (int i=0; i< n; i++)
-			{
-				w.push_back(w3[i]);
-			}
-			break;
-
-		case 5:
-			n = n5;
-			for (int i=0; i < n; i++)
-			{
-			x.push_back(x5[i]);
-			}
-			for (int i=0; i< n; i++)
-			{
-			w.push_back(w5[i]);
-			}
-			break;
-
-		case 7:
-			n = n7;
-			for (int i=0; i < n; i++)
-			{
-			x.push_back(x5[i]);
-			}
-			for (int i=0; i< n; i++)
-			{
-			w.push_back(w5[i]);
-			}
-			break;
-
-		case 9:
-			n = n9;
-			for (int i=0; i < n; i++)
-			{
-			x.push_back(x9[i]);
-			}
-			for (int i=0; i < n; i++)
-			{
-			w.push_back(w9[i]);
-			}
-			break;
-
-      default:
-        std::cout << "ERROR! Unsupported order! Aborting..." << std::endl;
+        std::cout << "ERROR! Unsupported order " << p << "! Aborting..." << std::endl;
         abort();
-        break;
     }
-}
\ No newline at end of file
+    n = rule_n[irule];
+    for (int i=0; i < n; i++)
+    {
+        x.push_back(rule_x[irule][i]);
+    }
+    for (int i=0; i < n; i++)
+    {
+        w.push_back(rule_w[irule][i]);
+    }
+}
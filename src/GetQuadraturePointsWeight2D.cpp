@@ -402,75 +402,30 @@ void GetQuadraturePointsWeight2D(int p, int &n, std::vector<double>& x, std::vec
     0.001899964427651
     };
 
-    // Output interface
-    switch (p)
+    // Output interface, the tabulated rule of the lowest order not below p.
+    // Order p = 0 is served by the one point rule, orders 11, 15, 16 and 18 by the next higher rule.
+    const int num_rule = 15;
+    int rule_order[num_rule] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 12, 13, 14, 17, 19};
+    int rule_n[num_rule] = {n1, n2, n3, n4, n5, n6, n7, n8, n9, n10, n12, n13, n14, n17, n19};
+    const double* rule_x[num_rule] = {x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x12, x13, x14, x17, x19};
+    const double* rule_w[num_rule] = {w1, w2, w3, w4, w5, w6, w7, w8, w9, w10, w12, w13, w14, w17, w19};
+    int irule = 0;
+    while (irule < num_rule && rule_order[irule] < p)
     {
-        case 0:
-          break;
-
-        case 1:
-          n = n1;
-          for (int i=0; i< 2 * n; i++)
-          {
-            x.push_back(x1[i]);
-          }
-          for (int i=0; i< n; i++)
-          {
-            w.push_back(w1[i]);
-          }
-          break;
-
-        case 2:
-          n = n2;
-          for (int i=0; i< 2 * n; i++)
-          {
-            x.push_back(x2[i]);
-          }
-          for (int i=0; i< n; i++)
-          {
-            w.push_back(w2[i]);
-          }
-          break;
-
-        case 3:
-          n = n3;
-          for (int i=0; i< 2 * n; i++)
-          {
-            x.push_back(x3[i]);
-          }
-          for (int i=0; i< n; i++)
-          {
-            w.push_back(w3[i]);
-          }
-          break;
-
-        case 5:
-          n = n5;
-          for (int i=0; i< 2 * n; i++)
-          {
-            x.push_back(x5[i]);
-          }
-          for (int i=0; i< n; i++)
-          {
-            w.push_back(w5[i]);
-          }
-          break;
-
-        case 9:
-        n = n9;
-        for (int i=0; i< 2 * n; i++)
-        {
-          x.push_back(x9[i]);
-        }
-        for (int i=0; i< n; i++)
-        {
-          w.push_back(w9[i]);
-        }
-        break;
-
-        default:
-          std::cout << "ERROR! Unsupported order! Aborting..." << std::endl;
-          abort();
-          break;
+        irule++;
+    }
+    if (irule >= num_rule)
+    {
+        std::cout << "ERROR! Unsupported order " << p << "! Aborting..." << std::endl;
+        abort();
+    }
+    n = rule_n[irule];
+    for (int i=0; i< 2 * n; i++)
+    {
+        x.push_back(rule_x[irule][i]);
+    }
+    for (int i=0; i< n; i++)
+    {
+        w.push_back(rule_w[irule][i]);
     }
-}
\ No newline at end of file
+}
@@ -17,6 +17,9 @@
 #include "../include/Param.h"
 #include "../include/Collective.h"
 #include "../include/InvertMatrix.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -25,22 +28,24 @@ int main(int argc, char *argv[])
     Param param;
     // Set up the param struct
     param = ReadParamIn(string(argv[1]));
-    TriMesh mesh(param.mesh_file);
+#ifdef _OPENMP
+    omp_set_num_threads(param.num_threads);
+#endif
     // Testing Calculate Residaul
     int p = param.order;
     int q = param.order_geo;
     int Np = int((p + 1) * (p + 2) / 2);
-    TriMesh curved_mesh = mesh;
+    TriMesh curved_mesh;
     string boundary_name="bottom";
-    ConstructCurveMesh(mesh, curved_mesh, geometry::BumpFunction, boundary_name, q);
+    LoadCurvedMesh(param.mesh_file, curved_mesh, geometry::BumpFunction, boundary_name, q, strcasecmp(param.mesh_cache.c_str(), "on") == 0);
 
     ResData resdata_postproc;
     if (p == 0)
     {
-        solver::CalcResData(curved_mesh, 1, resdata_postproc);
+        solver::CalcResData(curved_mesh, 1, param, resdata_postproc);
     }else
     {
-        solver::CalcResData(curved_mesh, p, resdata_postproc);
+        solver::CalcResData(curved_mesh, p, param, resdata_postproc);
     }
 
     int Np_solution;
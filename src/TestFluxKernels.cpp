@@ -0,0 +1,116 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "../include/euler.h"
+
+using namespace std;
+
+// Random conservative state, density and pressure in [0.5, 2], speed up to Mach 2 in any direction
+void RandomState(mt19937& generator, double gamma, double* u)
+{
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    double rho = 0.5 + 1.5 * unit(generator);
+    double p = 0.5 + 1.5 * unit(generator);
+    double speed = 2.0 * unit(generator) * sqrt(gamma * p / rho);
+    double angle = 2.0 * M_PI * unit(generator);
+    double vx = speed * cos(angle), vy = speed * sin(angle);
+    u[0] = rho;
+    u[1] = rho * vx;
+    u[2] = rho * vy;
+    u[3] = p / (gamma - 1) + 0.5 * rho * (vx * vx + vy * vy);
+}
+
+// Difference of a batched value to the scalar one, relative to the magnitude of the scalar one
+double Deviation(double batch, double scalar)
+{
+    return fabs(batch - scalar) / max(1.0, fabs(scalar));
+}
+
+// Largest deviation of the batched analytical and Roe fluxes from the scalar CalcAnalyticalFlux and
+// CalcRoeFlux on a batch of n random points, stored with a padded leading dimension. Every pair of
+// states is evaluated as given, with the sides swapped and with the normal flipped.
+double BatchDeviation(mt19937& generator, double gamma, int n)
+{
+    int ld_U = n + 3, ld_F = n + 5;
+    int n_point = 3 * n;
+    vector<double> UL(4 * ld_U * 3), UR(4 * ld_U * 3), nx(ld_U * 3), ny(ld_U * 3);
+    vector<double> uL(4 * n_point), uR(4 * n_point), normal(2 * n_point);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int i = 0; i < n; i++)
+    {
+        RandomState(generator, gamma, &uL[4 * i]);
+        RandomState(generator, gamma, &uR[4 * i]);
+        double angle = 2.0 * M_PI * unit(generator);
+        normal[2 * i] = cos(angle);
+        normal[2 * i + 1] = sin(angle);
+        for (int s = 0; s < 4; s++)
+        {
+            // Sides swapped, then the normal flipped
+            uL[4 * (n + i) + s] = uR[4 * i + s]; uR[4 * (n + i) + s] = uL[4 * i + s];
+            uL[4 * (2 * n + i) + s] = uL[4 * i + s]; uR[4 * (2 * n + i) + s] = uR[4 * i + s];
+        }
+        normal[2 * (n + i)] = normal[2 * i]; normal[2 * (n + i) + 1] = normal[2 * i + 1];
+        normal[2 * (2 * n + i)] = -normal[2 * i]; normal[2 * (2 * n + i) + 1] = -normal[2 * i + 1];
+    }
+    double deviation = 0.0;
+    for (int iset = 0; iset < 3; iset++)
+    {
+        // Structure of arrays of the batch, component s of point i at s * ld_U + i
+        for (int i = 0; i < n; i++)
+        {
+            int ip = iset * n + i;
+            for (int s = 0; s < 4; s++)
+            {
+                UL[s * ld_U + i] = uL[4 * ip + s];
+                UR[s * ld_U + i] = uR[4 * ip + s];
+            }
+            nx[i] = normal[2 * ip];
+            ny[i] = normal[2 * ip + 1];
+        }
+        vector<double> F(8 * ld_F), F_hat(4 * ld_F), mws(n);
+        euler::CalcAnalyticalFluxBatch(n, UL.data(), ld_U, gamma, F.data(), ld_F);
+        euler::CalcRoeFluxBatch(n, UL.data(), UR.data(), ld_U, nx.data(), ny.data(), gamma, F_hat.data(), ld_F, mws.data());
+        for (int i = 0; i < n; i++)
+        {
+            int ip = iset * n + i;
+            double F_scalar[8], F_hat_scalar[4], mws_scalar;
+            euler::CalcAnalyticalFlux(&uL[4 * ip], gamma, F_scalar);
+            euler::CalcRoeFlux(&uL[4 * ip], &uR[4 * ip], &normal[2 * ip], gamma, F_hat_scalar, mws_scalar);
+            for (int k = 0; k < 8; k++)
+                deviation = max(deviation, Deviation(F[k * ld_F + i], F_scalar[k]));
+            for (int s = 0; s < 4; s++)
+                deviation = max(deviation, Deviation(F_hat[s * ld_F + i], F_hat_scalar[s]));
+            deviation = max(deviation, Deviation(mws[i], mws_scalar));
+        }
+    }
+    return deviation;
+}
+
+// Batched flux kernels against the scalar path on random states, for batch sizes on and off the
+// SIMD width. Returns 1 if a batch deviates by more than round-off.
+// usage: test_fluxes.exe
+int main(int argc, char *argv[])
+{
+    const double gamma = 1.4;
+    const double tolerance = 1e-13;
+    const int batch_sizes[] = {1, 3, 4, 7, 8, 13, 16, 37, 64, 101};
+    mt19937 generator(2024);
+    bool passed = true;
+    for (int n : batch_sizes)
+    {
+        double deviation = 0.0;
+        for (int itrial = 0; itrial < 200; itrial++)
+        {
+            deviation = max(deviation, BatchDeviation(generator, gamma, n));
+        }
+        bool ok = deviation < tolerance;
+        passed = passed && ok;
+        std::cout << "  batch " << setw(4) << n << ": max deviation of F, F_hat and mws " << setprecision(3)
+                  << deviation << " " << (ok ? "ok" : "FAILED") << std::endl;
+    }
+    return passed ? 0 : 1;
+}
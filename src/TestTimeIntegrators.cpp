@@ -0,0 +1,54 @@
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+#include "../include/solver.h"
+#include "../include/Param.h"
+
+using namespace std;
+
+// Error at t = 1 of the integrator of param on du/dt = lambda u, u(0) = 1, with num_step steps.
+// The stages are applied as in solver::TimeMarching_SSPRK, the residual being R = -lambda u.
+double LinearOdeError(const Param& param, double lambda, int num_step)
+{
+    double step_length;
+    vector<array<double, 3> > stages = solver::StageCoefficients(param, step_length);
+    double dt = 1.0 / (num_step * step_length);
+    double u = 1.0;
+    for (int istep = 0; istep < num_step; istep++)
+    {
+        double u_0 = u;
+        u = u + dt * lambda * u;
+        for (int istage = 0; istage < stages.size(); istage++)
+        {
+            u = stages[istage][0] * u_0 + stages[istage][1] * u + stages[istage][2] * dt * lambda * u;
+        }
+    }
+    return fabs(u - exp(lambda));
+}
+
+// Observed order of accuracy of the time integrators on a linear ODE, from the errors with
+// num_step and 2 num_step steps. Returns 1 if an integrator misses its design order.
+// usage: test_integrators.exe
+int main(int argc, char *argv[])
+{
+    const double lambda = -1.0;
+    const int num_step = 40;
+    bool passed = true;
+    for (int m = 1; m <= 4; m++)
+    {
+        Param param;
+        param.time_integrator = (m == 1) ? "tvdrk3" : "ssprk2";
+        param.rk_stages = m;
+        int order = (m == 1) ? 3 : 2;
+        double error = LinearOdeError(param, lambda, num_step);
+        double error_half = LinearOdeError(param, lambda, 2 * num_step);
+        double observed = log2(error / error_half);
+        bool ok = fabs(observed - order) < 0.1;
+        passed = passed && ok;
+        std::cout << setw(8) << param.time_integrator << setw(4) << (m == 1 ? 3 : m) << " stages: error " << setprecision(4)
+                  << error << " -> " << error_half << ", order " << observed << " (expected " << order << ") "
+                  << (ok ? "ok" : "FAILED") << std::endl;
+    }
+    return passed ? 0 : 1;
+}
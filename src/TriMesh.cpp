@@ -1,17 +1,47 @@
 #include "../include/TriMesh.h"
 
+// Wall time in seconds since time_start
+static double Elapsed(chrono::steady_clock::time_point time_start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - time_start).count();
+}
+
+TriMesh::TriMesh()
+{
+    num_node = 0;
+    num_element = 0;
+    num_boundary = 0;
+    curved_group = -1;
+}
+
 TriMesh::TriMesh(string &gri_filename_in)
 {
     gri_filename = gri_filename_in;
+    SetupTime.clear();
+    chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
     ReadGri(this->gri_filename);
+    SetupTime.push_back(make_pair(string("ReadGri"), Elapsed(time_start)));
     this->isCurved = vector<bool> (this->E.size(), false);
     this->curved_group = -1;
     CalcArea();
-    CalcI2E();
-    CalcB2E();
+    // Edge index shared by the interior and boundary edge builders
+    time_start = chrono::steady_clock::now();
+    vector<pair<unsigned long long, int> > half_edge;
+    CalcHalfEdge(half_edge);
+    CalcI2E(half_edge);
+    SetupTime.push_back(make_pair(string("CalcI2E"), Elapsed(time_start)));
+    CalcI2EClass();
+    time_start = chrono::steady_clock::now();
+    CalcB2E(half_edge);
+    SetupTime.push_back(make_pair(string("CalcB2E"), Elapsed(time_start)));
+    time_start = chrono::steady_clock::now();
     CalcIn();
+    SetupTime.push_back(make_pair(string("CalcIn"), Elapsed(time_start)));
+    time_start = chrono::steady_clock::now();
     CalcBn();
+    SetupTime.push_back(make_pair(string("CalcBn"), Elapsed(time_start)));
     FindCurvedIndex();
+    CalcFaceColor();
 }
 
 TriMesh::TriMesh(TriMesh &mesh)
@@ -27,6 +57,7 @@ TriMesh::TriMesh(TriMesh &mesh)
     name_base = mesh.name_base;
     n_base = mesh.n_base;
     I2E = mesh.I2E;
+    I2EClass = mesh.I2EClass;
     B2E = mesh.B2E;
     In = mesh.In;
     Bn = mesh.Bn;
@@ -35,12 +66,238 @@ TriMesh::TriMesh(TriMesh &mesh)
     CurvedElementIndex = mesh.CurvedElementIndex;
     CurvedEdgeIndex = mesh.CurvedEdgeIndex;
     LinearElementIndex = mesh.LinearElementIndex;
+    B2EGroup = mesh.B2EGroup;
     LinearEdgeIndex = mesh.LinearEdgeIndex;
+    I2EColor = mesh.I2EColor;
+    B2EColor = mesh.B2EColor;
     curved_group = mesh.curved_group;
+    SetupTime = mesh.SetupTime;
+    ElemOriginal = mesh.ElemOriginal;
+}
+
+void ElementNodes::Assign(const vector<vector<int> >& rows)
+{
+    this->offset.resize(rows.size() + 1);
+    this->offset[0] = 0;
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        this->offset[i + 1] = this->offset[i] + rows[i].size();
+    }
+    this->node.resize(this->offset[rows.size()]);
+    for (size_t i = 0; i < rows.size(); i++)
+    {
+        for (size_t k = 0; k < rows[i].size(); k++)
+        {
+            this->node[this->offset[i] + k] = rows[i][k] - 1;
+        }
+    }
+}
+
+// Line of a memory-mapped file, [begin, end) without the line break
+struct GriLine
+{
+    const char* begin;
+    const char* end;
+};
+
+static bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Next whitespace separated token of the line, copied NUL-terminated into token, false at the end of the line
+static bool NextToken(GriLine& line, char* token, int max_length)
+{
+    while (line.begin < line.end && IsBlank(*line.begin))
+        line.begin++;
+    if (line.begin == line.end)
+        return false;
+    int length = 0;
+    while (line.begin < line.end && !IsBlank(*line.begin))
+    {
+        if (length < max_length - 1)
+            token[length++] = *line.begin;
+        line.begin++;
+    }
+    token[length] = '\0';
+    return true;
+}
+
+static bool NextInt(GriLine& line, int& value)
+{
+    while (line.begin < line.end && IsBlank(*line.begin))
+        line.begin++;
+    if (line.begin == line.end)
+        return false;
+    bool negative = (*line.begin == '-');
+    if (*line.begin == '-' || *line.begin == '+')
+        line.begin++;
+    long result = 0;
+    while (line.begin < line.end && *line.begin >= '0' && *line.begin <= '9')
+    {
+        result = 10 * result + (*line.begin - '0');
+        line.begin++;
+    }
+    // Skip whatever follows the digits within the token
+    while (line.begin < line.end && !IsBlank(*line.begin))
+        line.begin++;
+    value = int(negative ? -result : result);
+    return true;
+}
+
+static bool NextDouble(GriLine& line, double& value)
+{
+    char token[64];
+    if (!NextToken(line, token, 64))
+        return false;
+    value = strtod(token, NULL);
+    return true;
 }
 
 void TriMesh::ReadGri(string &gri_filename)
 {
+    // The file is memory-mapped and split into lines with one memchr pass, then the node and
+    // element blocks, which are one record per line, are parsed in parallel.
+    // Numbers are converted with strtod / strtol as the stream parser does, so the result is the same.
+    int fd = open(gri_filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0)
+    {
+        cout << "Cannot open the mesh file " << gri_filename << " Aborting..." << endl;
+        abort();
+    }
+    size_t file_size = file_stat.st_size;
+    const char* data = NULL;
+    if (file_size > 0)
+    {
+        void* map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            cout << "Cannot map the mesh file " << gri_filename << " Aborting..." << endl;
+            abort();
+        }
+        data = static_cast<const char*>(map);
+    }
+    vector<GriLine> lines;
+    const char* position = data;
+    const char* data_end = data + file_size;
+    while (position < data_end)
+    {
+        const char* line_end = static_cast<const char*>(memchr(position, '\n', data_end - position));
+        if (line_end == NULL)
+            line_end = data_end;
+        GriLine line = {position, line_end};
+        lines.push_back(line);
+        position = line_end + 1;
+    }
+    size_t iline = 0;
+    GriLine empty_line = {data_end, data_end};
+    auto next_line = [&]() { return iline < lines.size() ? lines[iline++] : empty_line; };
+
+    // Variables
+    int num_node = 0, num_element = 0, dim = 0, num_boundary = 0, n_base = 0;
+    // Read the first line, get Nn, Ne, dim
+    GriLine line = next_line();
+    NextInt(line, num_node); NextInt(line, num_element); NextInt(line, dim);
+
+    // Read the V matrix, which are the coordinates of the nodes
+    if (iline + num_node > lines.size())
+    {
+        cout << "The mesh file " << gri_filename << " ends within the nodes, Aborting..." << endl;
+        abort();
+    }
+    NodeCoordinates V;
+    V.resize(num_node);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_node; i++)
+    {
+        GriLine node_line = lines[iline + i];
+        NextDouble(node_line, V.x[i]);
+        NextDouble(node_line, V.y[i]);
+    }
+    iline += num_node;
+
+    // Read number of boundaries
+    line = next_line();
+    NextInt(line, num_boundary);
+
+    // Read boundary information
+    vector<string> Bname(num_boundary);
+    vector<vector<vector<int>>> B(num_boundary);
+    char token[256];
+    for (int i_boundary = 0; i_boundary < num_boundary; i_boundary++)
+    {
+        // The information of a specific boundary
+        int num_boundary_edge = 0, dim_boundary = 0;
+        line = next_line();
+        NextInt(line, num_boundary_edge); NextInt(line, dim_boundary);
+        Bname[i_boundary] = NextToken(line, token, 256) ? string(token) : string();
+        B[i_boundary].resize(num_boundary_edge, vector<int>(2));
+        for (int i = 0; i < num_boundary_edge; i++)
+        {
+            line = next_line();
+            NextInt(line, B[i_boundary][i][0]); NextInt(line, B[i_boundary][i][1]);
+        }
+    }
+
+    // Read element information, in parts of one basis each, straight into the flat element nodes
+    ElementNodes E;
+    E.offset.assign(1, 0);
+    E.offset.reserve(num_element + 1);
+    vector<string> name_base;
+    vector<int> n_bases;
+    int current_total_elements = 0;
+    while (current_total_elements < num_element)
+    {
+        int num_element_part = 0;
+        line = next_line();
+        NextInt(line, num_element_part); NextInt(line, n_base);
+        n_bases.push_back(n_base);
+        name_base.push_back(NextToken(line, token, 256) ? string(token) : string());
+        if (num_element_part <= 0 || current_total_elements + num_element_part > num_element || iline + num_element_part > lines.size())
+        {
+            cout << "Invalid element block in the mesh file " << gri_filename << " Aborting..." << endl;
+            abort();
+        }
+        int nnode = (n_base + 1) * (n_base + 2) / 2;
+        int first_node = E.node.size();
+        for (int i_element = 0; i_element < num_element_part; i_element++)
+        {
+            E.offset.push_back(first_node + (i_element + 1) * nnode);
+        }
+        E.node.resize(first_node + num_element_part * nnode);
+        #pragma omp parallel for schedule(static)
+        for (int i_element = 0; i_element < num_element_part; i_element++)
+        {
+            GriLine element_line = lines[iline + i_element];
+            int* element = &E.node[first_node + i_element * nnode];
+            for (int i_local_node = 0; i_local_node < nnode; i_local_node++)
+            {
+                NextInt(element_line, element[i_local_node]);
+                element[i_local_node]--;
+            }
+        }
+        iline += num_element_part;
+        current_total_elements += num_element_part;
+    }
+    if (data != NULL)
+        munmap(const_cast<char*>(data), file_size);
+    close(fd);
+
+    this->num_boundary = num_boundary;
+    this->num_element = num_element;
+    this->num_node = num_node;
+    this->name_base = name_base;
+    this->n_base = n_bases;
+    this->B = B;
+    this->Bname = Bname;
+    this->E = std::move(E);
+    this->V = V;
+}
+
+void TriMesh::ReadGriStream(string &gri_filename)
+{
+    // Reference line-by-line parser, kept to check and benchmark ReadGri against
 
     // variables dealing with strings
     ifstream gri_file(gri_filename);
@@ -55,13 +312,14 @@ void TriMesh::ReadGri(string &gri_filename)
     ss >> num_node >> num_element >> dim;
 
     // Read the V matrix, which are the coordinates of the nodes
-    vector<vector<double>> V(num_node, vector<double>(2));
+    NodeCoordinates V;
+    V.resize(num_node);
     for (int i = 0; i < num_node; i++)
     {
         getline(gri_file, line);
         ss.clear();
         ss.str(line);
-        ss >> V[i][0] >> V[i][1];
+        ss >> V.x[i] >> V.y[i];
     }
 
     // Read number of boundaries
@@ -139,123 +397,114 @@ void TriMesh::ReadGri(string &gri_filename)
     this->n_base = n_bases;
     this->B = B;
     this->Bname = Bname;
-    this->E = E;
+    this->E.Assign(E);
     this->V = V;
 }
 
-void TriMesh::CalcI2E()
+void TriMesh::CalcHalfEdge(vector<pair<unsigned long long, int> >& half_edge)
 {
-    // This function is re-written from the Python version, so the names of the
-    // variables are not well-organized
-    vector<vector<int>> E = this->E;
-    vector<vector<double>> V = this->V;
-    int N = this->num_node;
-    boost::numeric::ublas::mapped_matrix<int> H(N, N, N * N);
-    vector<vector<int>> C(this->num_element * 3, vector<int>(4, 0));
-    int nedge = 0;
-    for (int t = 0; t < this->num_element; t++)
+    // Every element contributes its three edges as half-edges keyed by the 64-bit vertex pair
+    // (nmin, nmax), half-edge e of element t being 3 t + e. After sorting the keys, the two
+    // half-edges of an interior edge are adjacent, so edges are found in O(E log E) without
+    // any node x node table. Ties of the key are broken by the element.
+    const ElementNodes& E = this->E;
+    int num_element = this->num_element;
+    half_edge.resize(3 * num_element);
+    #pragma omp parallel for
+    for (int t = 0; t < num_element; t++)
     {
-        vector<int> vertex_index(3);
-        vertex_index = utils::GetVertexIndex(E[t]);
+        vector<int> vertex_index = utils::GetVertexIndex(E.RowSize(t));
         for (int e = 0; e < 3; e++)
         {
-            int n1 = E[t][vertex_index[(e + 1) % 3]] - 1;
-            int n2 = E[t][vertex_index[(e + 2) % 3]] - 1;
-            int nmin = min(n1, n2);
-            int nmax = max(n1, n2);
-            if (H(nmin, nmax) > 0)
-            {
-                int tN = H(nmin, nmax);
-                int eN = H(nmax, nmin);
-                int t1 = t + 1;
-                int t2 = tN;
-                int e1 = e + 1;
-                int e2 = eN;
-                if (t2 < t1)
-                {
-                    t1 = tN;
-                    t2 = t + 1;
-                    e1 = eN;
-                    e2 = e + 1;
-                }
-                C[nedge][0] = t1;
-                C[nedge][1] = e1;
-                C[nedge][2] = t2;
-                C[nedge][3] = e2;
-                nedge = nedge + 1;
-            }
-            else
-            {
-                H(nmin, nmax) = t + 1;
-                H(nmax, nmin) = e + 1;
-            }
+            half_edge[3 * t + e] = make_pair(EdgeKey(E[t][vertex_index[(e + 1) % 3]], E[t][vertex_index[(e + 2) % 3]]), 3 * t + e);
         }
     }
-    // Sorting
-    vector<vector<int>> CC(nedge, vector<int>(4, 0));
-    for (int i = 0; i < nedge; i++)
+    sort(half_edge.begin(), half_edge.end());
+}
+
+unsigned long long TriMesh::EdgeKey(int n1, int n2)
+{
+    unsigned long long nmin = min(n1, n2) - 1;
+    unsigned long long nmax = max(n1, n2) - 1;
+    return (nmin << 32) | nmax;
+}
+
+void TriMesh::CalcI2E(const vector<pair<unsigned long long, int> >& half_edge)
+{
+    // The left element of an interior edge is the one with the lower index, which comes first
+    // in half_edge, and the edges are ordered by left element, then by right element.
+    int num_element = this->num_element;
+    vector<array<int, 4> > edge;
+    edge.reserve(3 * num_element / 2);
+    for (int i = 0; i + 1 < half_edge.size(); i++)
     {
-        for (int j = 0; j < 4; j++)
+        if (half_edge[i].first == half_edge[i + 1].first)
         {
-            CC[i][j] = C[i][j];
+            int t1 = half_edge[i].second / 3, e1 = half_edge[i].second % 3;
+            int t2 = half_edge[i + 1].second / 3, e2 = half_edge[i + 1].second % 3;
+            edge.push_back({{t1 + 1, e1 + 1, t2 + 1, e2 + 1}});
+            i++;
         }
     }
-    sort(CC.begin(), CC.end(), utils::SortByColumn0);
-    int i0 = 0;
-    for (int i = 0; i < nedge; i++)
+    sort(edge.begin(), edge.end(), [](const array<int, 4>& a, const array<int, 4>& b)
+                                   { return a[0] < b[0] || (a[0] == b[0] && a[2] < b[2]); });
+    this->I2E.resize(edge.size());
+    for (int iedge = 0; iedge < edge.size(); iedge++)
     {
-        if (CC[i][0] != CC[i0][0])
-        {
-            vector<vector<int>> A = utils::SliceByRow(CC, i0, i - 1);
-            sort(A.begin(), A.end(), utils::SortByColumn2);
-            for (int ii = i0; ii < i; ii++)
-            {
-                for (int jj = 0; jj < 4; jj++)
-                {
-                    CC[ii][jj] = A[ii - i0][jj];
-                }
-            }
-            i0 = i;
-        }
+        this->I2E.elemL[iedge] = edge[iedge][0] - 1; this->I2E.locL[iedge] = edge[iedge][1] - 1;
+        this->I2E.elemR[iedge] = edge[iedge][2] - 1; this->I2E.locR[iedge] = edge[iedge][3] - 1;
     }
-    this->I2E = CC;
 }
 
-void TriMesh::CalcB2E()
+void TriMesh::CalcI2EClass()
 {
-    // This function is re-written from the Python version, so the names of the
-    // variables are not well-organized
-    vector<vector<int>> E = this->E;
-    vector<vector<vector<int>>> B = this->B;
-    vector<vector<int>> B2E;
+    // Group the interior edges by the local indices of the edge in the left and right
+    // elements, so the trace tables are the same for every edge in a group
+    this->I2EClass = vector<vector<int> > (9);
+    for (int iedge = 0; iedge < this->I2E.size(); iedge++)
+    {
+        int ilocL = this->I2E.locL[iedge];
+        int ilocR = this->I2E.locR[iedge];
+        this->I2EClass[3 * ilocL + ilocR].push_back(iedge);
+    }
+}
 
-    for (int ielem = 0; ielem < E.size(); ielem++)
+void TriMesh::CalcB2E(const vector<pair<unsigned long long, int> >& half_edge)
+{
+    // One lookup of every boundary edge in the sorted half-edge index, O(Nb log E).
+    // The rows are put in the order of the former element-by-element search, then grouped
+    // by boundary group with the same sort, so B2E does not change.
+    vector<array<int, 4> > found; // element, group, position in the group, local edge
+    for (int ibg = 0; ibg < this->Bname.size(); ibg++)
     {
-        vector<int> vertex_index(3), elem(3);
-        vertex_index = utils::GetVertexIndex(E[ielem]);
-        for (int i = 0; i < 3; i++)
+        const vector<vector<int> >& B_part = this->B[ibg];
+        for (int ib = 0; ib < B_part.size(); ib++)
         {
-            elem[i] = E[ielem][i];
-        }
-        for (int ibg = 0; ibg < this->Bname.size(); ibg++)
-        {
-            vector<vector<int>> B_part = B[ibg];
-            for (int ib = 0; ib < B_part.size(); ib++)
+            pair<unsigned long long, int> first_half_edge = make_pair(EdgeKey(B_part[ib][0], B_part[ib][1]), -1);
+            vector<pair<unsigned long long, int> >::const_iterator it = lower_bound(half_edge.begin(), half_edge.end(), first_half_edge);
+            if (it == half_edge.end() || it->first != first_half_edge.first)
             {
-                vector<int> nb = B_part[ib];
-                int match_1 = distance(elem.begin(), find(elem.begin(), elem.end(), nb[0]));
-                int match_2 = distance(elem.begin(), find(elem.begin(), elem.end(), nb[1]));
-                if ((match_1 != elem.size()) && (match_2 != elem.size()))
-                {
-                    int local_ind = utils::MissingFrom012(match_1, match_2);
-                    vector<int> row = {ielem + 1, local_ind + 1, ibg + 1};
-                    B2E.push_back(row);
-                }
+                std::cout << "Boundary edge " << B_part[ib][0] << ' ' << B_part[ib][1] << " of " << this->Bname[ibg]
+                          << " is not an element edge, Aborting..." << std::endl;
+                abort();
             }
+            found.push_back({{it->second / 3, ibg, ib, it->second % 3}});
         }
     }
+    sort(found.begin(), found.end());
+    vector<vector<int> > B2E(found.size(), vector<int>(3));
+    for (int i = 0; i < found.size(); i++)
+    {
+        B2E[i][0] = found[i][0] + 1; B2E[i][1] = found[i][3] + 1; B2E[i][2] = found[i][1] + 1;
+    }
     sort(B2E.begin(), B2E.end(), utils::SortByColumn2);
-    this->B2E = B2E;
+    this->B2E.resize(B2E.size());
+    for (int iedge = 0; iedge < B2E.size(); iedge++)
+    {
+        this->B2E.elemL[iedge] = B2E[iedge][0] - 1;
+        this->B2E.locL[iedge] = B2E[iedge][1] - 1;
+        this->B2E.group[iedge] = B2E[iedge][2] - 1;
+    }
 }
 
 void TriMesh::FindCurvedIndex()
@@ -277,7 +526,7 @@ void TriMesh::FindCurvedIndex()
     }
     for (int i = 0; i < this->Bn.size(); i++)
     {
-        if (this->Bn[i][3] > 0)
+        if (this->Bn.curved[i])
         {
             this->CurvedEdgeIndex.push_back(i);
         }
@@ -286,57 +535,248 @@ void TriMesh::FindCurvedIndex()
             this->LinearEdgeIndex.push_back(i);
         }
     }
+    // Group the boundary edges by boundary, keeping the curved edges first
+    this->B2EGroup.assign(int(this->num_boundary), vector<int>());
+    for (int i = 0; i < this->CurvedEdgeIndex.size(); i++)
+    {
+        int iedge = this->CurvedEdgeIndex[i];
+        this->B2EGroup[this->B2E.group[iedge]].push_back(iedge);
+    }
+    for (int i = 0; i < this->LinearEdgeIndex.size(); i++)
+    {
+        int iedge = this->LinearEdgeIndex[i];
+        this->B2EGroup[this->B2E.group[iedge]].push_back(iedge);
+    }
+}
+
+void TriMesh::CalcFaceColor()
+{
+    // Partition the edges into colors such that no two edges of a color share an element.
+    // Edges are colored in the order the residual visits them (interior edges class by class,
+    // boundary edges group by group), and an edge takes the color after the last color used by
+    // either of its elements. Then every element still receives its edge contributions in the
+    // serial order when the colors are processed one after another.
+    vector<int> last_color(this->num_element, -1);
+    this->I2EColor.clear();
+    for (int iclass = 0; iclass < this->I2EClass.size(); iclass++)
+    {
+        for (int i = 0; i < this->I2EClass[iclass].size(); i++)
+        {
+            int iedge = this->I2EClass[iclass][i];
+            int ielemL = this->I2E.elemL[iedge];
+            int ielemR = this->I2E.elemR[iedge];
+            int icolor = max(last_color[ielemL], last_color[ielemR]) + 1;
+            last_color[ielemL] = icolor;
+            last_color[ielemR] = icolor;
+            if (this->I2EColor.size() < 9 * (icolor + 1))
+            {
+                this->I2EColor.resize(9 * (icolor + 1));
+            }
+            this->I2EColor[9 * icolor + iclass].push_back(iedge);
+        }
+    }
+
+    fill(last_color.begin(), last_color.end(), -1);
+    this->B2EColor.clear();
+    vector<int> boundary_order;
+    for (int igroup = 0; igroup < this->B2EGroup.size(); igroup++)
+    {
+        boundary_order.insert(boundary_order.end(), this->B2EGroup[igroup].begin(), this->B2EGroup[igroup].end());
+    }
+    for (int i = 0; i < boundary_order.size(); i++)
+    {
+        int iedge = boundary_order[i];
+        int ielem = this->B2E.elemL[iedge];
+        int icolor = last_color[ielem] + 1;
+        last_color[ielem] = icolor;
+        if (this->B2EColor.size() < icolor + 1)
+        {
+            this->B2EColor.resize(icolor + 1);
+        }
+        this->B2EColor[icolor].push_back(iedge);
+    }
 }
 
 void TriMesh::CalcIn()
 {
     int num_edge = this->I2E.size();
-    vector<vector<double> > In(num_edge,  vector<double> (3));
+    this->In.nx.resize(num_edge); this->In.ny.resize(num_edge); this->In.len.resize(num_edge);
+    this->In.curved.clear();
+    #pragma omp parallel for
     for (int iedge = 0; iedge < num_edge; iedge++)
     {
-        int ielemL = this->I2E[iedge][0] - 1;
-        int ilocL = this->I2E[iedge][1] - 1;
+        int ielemL = this->I2E.elemL[iedge];
+        int ilocL = this->I2E.locL[iedge];
+        vector<int> ind_vertex = utils::GetVertexIndex(this->E.RowSize(ielemL));
         int ilocA = (ilocL + 1) % 3;
         int ilocB = (ilocL + 2) % 3;
-        int iglobA = this->E[ielemL][ilocA] - 1;
-        int iglobB = this->E[ielemL][ilocB] - 1;
-        double xA = this->V[iglobA][0]; double yA = this->V[iglobA][1];
-        double xB = this->V[iglobB][0]; double yB = this->V[iglobB][1];
+        int iglobA = this->E[ielemL][ind_vertex[ilocA]] - 1;
+        int iglobB = this->E[ielemL][ind_vertex[ilocB]] - 1;
+        double xA = this->V.x[iglobA]; double yA = this->V.y[iglobA];
+        double xB = this->V.x[iglobB]; double yB = this->V.y[iglobB];
         double dl = sqrt((xA - xB) * (xA - xB) + (yA - yB) * (yA - yB));
-        In[iedge][2] = dl;
-        In[iedge][0] = (yB - yA) / dl; In[iedge][1] = (xA - xB) / dl;
+        this->In.len[iedge] = dl;
+        this->In.nx[iedge] = (yB - yA) / dl; this->In.ny[iedge] = (xA - xB) / dl;
     }
-    this->In = In;
 }
 
 void TriMesh::CalcBn()
 {
     int num_bedge = this->B2E.size();
-    vector<vector<double> > Bn(num_bedge, vector<double> (4));
-    this->Bn.clear();
+    this->Bn.nx.resize(num_bedge); this->Bn.ny.resize(num_bedge); this->Bn.len.resize(num_bedge);
+    this->Bn.curved.resize(num_bedge);
     for (int iedge = 0; iedge < num_bedge; iedge++)
     {
-        int ielem = this->B2E[iedge][0] - 1;
-        int iloc = this->B2E[iedge][1] - 1;
-        vector<int> ind_vertex = utils::GetVertexIndex(this->E[ielem]);
+        int ielem = this->B2E.elemL[iedge];
+        int iloc = this->B2E.locL[iedge];
+        vector<int> ind_vertex = utils::GetVertexIndex(this->E.RowSize(ielem));
         int ilocA = (iloc + 1) % 3;
         int ilocB = (iloc + 2) % 3;
         int iglobA = this->E[ielem][ind_vertex[ilocA]] - 1;
         int iglobB = this->E[ielem][ind_vertex[ilocB]] - 1;
-        double xA = this->V[iglobA][0]; double yA = this->V[iglobA][1];
-        double xB = this->V[iglobB][0]; double yB = this->V[iglobB][1];
+        double xA = this->V.x[iglobA]; double yA = this->V.y[iglobA];
+        double xB = this->V.x[iglobB]; double yB = this->V.y[iglobB];
         double dl = sqrt((xA - xB) * (xA - xB) + (yA - yB) * (yA - yB));
-        Bn[iedge][2] = dl;
-        Bn[iedge][0] = (yB - yA) / dl; Bn[iedge][1] = (xA - xB) / dl;
-        if(this->B2E[iedge][2] == this->curved_group)
+        this->Bn.len[iedge] = dl;
+        this->Bn.nx[iedge] = (yB - yA) / dl; this->Bn.ny[iedge] = (xA - xB) / dl;
+        this->Bn.curved[iedge] = (this->B2E.group[iedge] + 1 == this->curved_group) ? 1 : 0;
+    }
+}
+
+void TriMesh::Renumber(const vector<int>& element_order)
+{
+    int num_element = this->num_element;
+    int num_node = this->V.size();
+    // New node numbers in the order of first use by the new elements, nodes used by no element go last
+    vector<int> node_new(num_node, -1);
+    int inode_new = 0;
+    for (int ielem = 0; ielem < num_element; ielem++)
+    {
+        int iold = element_order[ielem];
+        for (int k = this->E.offset[iold]; k < this->E.offset[iold + 1]; k++)
         {
-            Bn[iedge][3] = 1;
-        } else
+            if (node_new[this->E.node[k]] < 0)
+                node_new[this->E.node[k]] = inode_new++;
+        }
+    }
+    for (int inode = 0; inode < num_node; inode++)
+    {
+        if (node_new[inode] < 0)
+            node_new[inode] = inode_new++;
+    }
+
+    ElementNodes E;
+    E.offset.resize(num_element + 1);
+    E.offset[0] = 0;
+    E.node.resize(this->E.node.size());
+    vector<bool> isCurved(num_element);
+    vector<double> Area(num_element);
+    vector<int> ElemOriginal(num_element);
+    for (int ielem = 0; ielem < num_element; ielem++)
+    {
+        int iold = element_order[ielem];
+        E.offset[ielem + 1] = E.offset[ielem] + this->E.RowSize(iold);
+        for (int k = 0; k < this->E.RowSize(iold); k++)
         {
-            Bn[iedge][3] = 0;
+            E.node[E.offset[ielem] + k] = node_new[this->E.node[this->E.offset[iold] + k]];
         }
+        isCurved[ielem] = this->isCurved[iold];
+        Area[ielem] = this->Area[iold];
+        ElemOriginal[ielem] = this->ElemOriginal.empty() ? iold : this->ElemOriginal[iold];
+    }
+    NodeCoordinates V;
+    V.resize(num_node);
+    for (int inode = 0; inode < num_node; inode++)
+    {
+        V.x[node_new[inode]] = this->V.x[inode];
+        V.y[node_new[inode]] = this->V.y[inode];
     }
-    this->Bn = Bn;
+    for (int ibg = 0; ibg < this->B.size(); ibg++)
+    {
+        for (int ib = 0; ib < this->B[ibg].size(); ib++)
+        {
+            for (int k = 0; k < this->B[ibg][ib].size(); k++)
+            {
+                this->B[ibg][ib][k] = node_new[this->B[ibg][ib][k] - 1] + 1;
+            }
+        }
+    }
+    this->E = std::move(E);
+    this->V = std::move(V);
+    this->isCurved = std::move(isCurved);
+    this->Area = std::move(Area);
+    this->ElemOriginal = std::move(ElemOriginal);
+
+    vector<pair<unsigned long long, int> > half_edge;
+    CalcHalfEdge(half_edge);
+    CalcI2E(half_edge);
+    CalcI2EClass();
+    CalcB2E(half_edge);
+    CalcIn();
+    CalcBn();
+    FindCurvedIndex();
+    CalcFaceColor();
+}
+
+vector<int> TriMesh::ElementsInFileOrder() const
+{
+    vector<int> element_index(this->num_element);
+    for (int ielem = 0; ielem < this->num_element; ielem++)
+    {
+        element_index[this->ElemOriginal.empty() ? ielem : this->ElemOriginal[ielem]] = ielem;
+    }
+    return element_index;
+}
+
+template <typename T>
+static double ArrayBytes(const vector<T>& v)
+{
+    return sizeof(vector<T>) + v.capacity() * sizeof(T);
+}
+
+template <typename T>
+static double RaggedBytes(const vector<vector<T> >& v)
+{
+    double bytes = sizeof(vector<vector<T> >) + v.capacity() * sizeof(vector<T>);
+    for (size_t i = 0; i < v.size(); i++)
+        bytes += v[i].capacity() * sizeof(T);
+    return bytes;
+}
+
+// Bytes of num_rows rows of row_size values of T held as vectors of row vectors
+template <typename T>
+static double NestedBytes(size_t num_rows, size_t row_size)
+{
+    return sizeof(vector<vector<T> >) + num_rows * (sizeof(vector<T>) + row_size * sizeof(T));
+}
+
+double TriMesh::MemoryBytes(bool nested_rows) const
+{
+    double bytes = 0.0;
+    if (nested_rows)
+    {
+        bytes += sizeof(vector<vector<int> >) + this->E.size() * sizeof(vector<int>) + this->E.node.size() * sizeof(int);
+        bytes += NestedBytes<double>(this->V.size(), 2);
+        bytes += NestedBytes<int>(this->I2E.size(), 4);
+        bytes += NestedBytes<int>(this->B2E.size(), 3);
+        bytes += NestedBytes<double>(this->In.size(), 3);
+        bytes += NestedBytes<double>(this->Bn.size(), 4);
+    }else
+    {
+        bytes += ArrayBytes(this->E.offset) + ArrayBytes(this->E.node);
+        bytes += ArrayBytes(this->V.x) + ArrayBytes(this->V.y);
+        bytes += ArrayBytes(this->I2E.elemL) + ArrayBytes(this->I2E.locL) + ArrayBytes(this->I2E.elemR) + ArrayBytes(this->I2E.locR);
+        bytes += ArrayBytes(this->B2E.elemL) + ArrayBytes(this->B2E.locL) + ArrayBytes(this->B2E.group);
+        bytes += ArrayBytes(this->In.nx) + ArrayBytes(this->In.ny) + ArrayBytes(this->In.len);
+        bytes += ArrayBytes(this->Bn.nx) + ArrayBytes(this->Bn.ny) + ArrayBytes(this->Bn.len) + ArrayBytes(this->Bn.curved);
+    }
+    for (size_t ibg = 0; ibg < this->B.size(); ibg++)
+        bytes += RaggedBytes(this->B[ibg]);
+    bytes += ArrayBytes(this->Area) + this->isCurved.size() / 8.0 + ArrayBytes(this->ElemOriginal);
+    bytes += RaggedBytes(this->I2EClass) + RaggedBytes(this->B2EGroup) + RaggedBytes(this->I2EColor) + RaggedBytes(this->B2EColor);
+    bytes += ArrayBytes(this->CurvedElementIndex) + ArrayBytes(this->LinearElementIndex);
+    bytes += ArrayBytes(this->CurvedEdgeIndex) + ArrayBytes(this->LinearEdgeIndex);
+    return bytes;
 }
 
 void TriMesh::CalcArea()
@@ -386,4 +826,294 @@ void TriMesh::WriteGri(string& gri_filename)
 
     }
     outfile.close();
-}
\ No newline at end of file
+}
+// Binary mesh format, all little-endian native types:
+//   header: magic "DGMESHB", format version, hash of the source .gri, order_geo
+//   scalars, then every array as its length followed by the flat data. Ragged arrays
+//   (vector of vectors) are stored as row offsets plus the flat rows, strings as length plus characters.
+static const char binary_magic[8] = {'D', 'G', 'M', 'E', 'S', 'H', 'B', '\0'};
+static const int binary_version = 2;
+
+template <typename T>
+static void WriteArray(ofstream& outfile, const vector<T>& v)
+{
+    unsigned long long n = v.size();
+    outfile.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    if (n > 0)
+        outfile.write(reinterpret_cast<const char*>(v.data()), n * sizeof(T));
+}
+
+template <typename T>
+static void WriteRagged(ofstream& outfile, const vector<vector<T> >& v)
+{
+    vector<unsigned long long> offset(v.size() + 1, 0);
+    for (size_t i = 0; i < v.size(); i++)
+        offset[i + 1] = offset[i] + v[i].size();
+    vector<T> flat;
+    flat.reserve(offset.back());
+    for (size_t i = 0; i < v.size(); i++)
+        flat.insert(flat.end(), v[i].begin(), v[i].end());
+    WriteArray(outfile, offset);
+    WriteArray(outfile, flat);
+}
+
+static void WriteStrings(ofstream& outfile, const vector<string>& v)
+{
+    vector<vector<char> > chars(v.size());
+    for (size_t i = 0; i < v.size(); i++)
+        chars[i].assign(v[i].begin(), v[i].end());
+    WriteRagged(outfile, chars);
+}
+
+// Bounded reader over the mapped file, every read fails once the data runs out
+struct BinaryCursor
+{
+    const char* position;
+    const char* end;
+    bool ok;
+};
+
+template <typename T>
+static void ReadArray(BinaryCursor& cursor, vector<T>& v)
+{
+    unsigned long long n = 0;
+    if (cursor.ok && size_t(cursor.end - cursor.position) >= sizeof(n))
+    {
+        memcpy(&n, cursor.position, sizeof(n));
+        cursor.position += sizeof(n);
+    }
+    else
+        cursor.ok = false;
+    if (!cursor.ok || n > size_t(cursor.end - cursor.position) / sizeof(T))
+    {
+        cursor.ok = false;
+        v.clear();
+        return;
+    }
+    v.resize(n);
+    if (n > 0)
+        memcpy(&v[0], cursor.position, n * sizeof(T));
+    cursor.position += n * sizeof(T);
+}
+
+template <typename T>
+static void ReadRagged(BinaryCursor& cursor, vector<vector<T> >& v)
+{
+    vector<unsigned long long> offset;
+    vector<T> flat;
+    ReadArray(cursor, offset);
+    ReadArray(cursor, flat);
+    if (!cursor.ok || offset.empty() || offset.back() != flat.size())
+    {
+        cursor.ok = false;
+        v.clear();
+        return;
+    }
+    v.resize(offset.size() - 1);
+    for (size_t i = 0; i + 1 < offset.size(); i++)
+        v[i].assign(flat.begin() + offset[i], flat.begin() + offset[i + 1]);
+}
+
+static void ReadStrings(BinaryCursor& cursor, vector<string>& v)
+{
+    vector<vector<char> > chars;
+    ReadRagged(cursor, chars);
+    v.resize(chars.size());
+    for (size_t i = 0; i < chars.size(); i++)
+        v[i].assign(chars[i].begin(), chars[i].end());
+}
+
+static vector<char> BoolsToChars(const vector<bool>& v)
+{
+    return vector<char>(v.begin(), v.end());
+}
+
+unsigned long long TriMesh::HashFile(const string& filename)
+{
+    // 64-bit FNV-1a over 8-byte words, the tail byte by byte, of the memory-mapped file
+    const unsigned long long prime = 0x100000001b3ULL;
+    unsigned long long hash = 0xcbf29ce484222325ULL;
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    size_t file_size = file_stat.st_size;
+    if (file_size > 0)
+    {
+        void* map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            const char* data = static_cast<const char*>(map);
+            size_t i = 0;
+            for (; i + 8 <= file_size; i += 8)
+            {
+                unsigned long long word;
+                memcpy(&word, data + i, 8);
+                hash = (hash ^ word) * prime;
+            }
+            for (; i < file_size; i++)
+            {
+                hash = (hash ^ (unsigned char)(data[i])) * prime;
+            }
+            munmap(map, file_size);
+        }
+    }
+    close(fd);
+    return (hash ^ file_size) * prime;
+}
+
+void TriMesh::WriteBinary(string& filename, unsigned long long source_hash, int order_geo)
+{
+    // Written to a temporary file of this process and renamed, so a concurrent run never maps a partial
+    // file and concurrent writers never share one, the last rename wins with a complete cache
+    string temp_filename = filename + ".tmp." + to_string(getpid());
+    ofstream outfile(temp_filename, ios::binary);
+    outfile.write(binary_magic, sizeof(binary_magic));
+    outfile.write(reinterpret_cast<const char*>(&binary_version), sizeof(binary_version));
+    outfile.write(reinterpret_cast<const char*>(&source_hash), sizeof(source_hash));
+    outfile.write(reinterpret_cast<const char*>(&order_geo), sizeof(order_geo));
+    vector<double> scalars = {this->num_node, double(this->num_element), this->num_boundary, double(this->curved_group)};
+    WriteArray(outfile, scalars);
+    WriteArray(outfile, this->E.offset);
+    WriteArray(outfile, this->E.node);
+    WriteArray(outfile, this->V.x);
+    WriteArray(outfile, this->V.y);
+    vector<vector<int> > B_flat;
+    vector<unsigned long long> B_count;
+    for (size_t ibg = 0; ibg < this->B.size(); ibg++)
+    {
+        B_count.push_back(this->B[ibg].size());
+        B_flat.insert(B_flat.end(), this->B[ibg].begin(), this->B[ibg].end());
+    }
+    WriteArray(outfile, B_count);
+    WriteRagged(outfile, B_flat);
+    WriteArray(outfile, this->Area);
+    WriteStrings(outfile, this->Bname);
+    WriteStrings(outfile, this->name_base);
+    WriteArray(outfile, this->n_base);
+    WriteArray(outfile, this->I2E.elemL); WriteArray(outfile, this->I2E.locL);
+    WriteArray(outfile, this->I2E.elemR); WriteArray(outfile, this->I2E.locR);
+    WriteRagged(outfile, this->I2EClass);
+    WriteArray(outfile, this->B2E.elemL); WriteArray(outfile, this->B2E.locL); WriteArray(outfile, this->B2E.group);
+    WriteArray(outfile, this->In.nx); WriteArray(outfile, this->In.ny); WriteArray(outfile, this->In.len);
+    WriteArray(outfile, this->Bn.nx); WriteArray(outfile, this->Bn.ny); WriteArray(outfile, this->Bn.len);
+    WriteArray(outfile, this->Bn.curved);
+    WriteArray(outfile, BoolsToChars(this->isCurved));
+    WriteArray(outfile, this->CurvedElementIndex);
+    WriteArray(outfile, this->LinearElementIndex);
+    WriteArray(outfile, this->CurvedEdgeIndex);
+    WriteArray(outfile, this->LinearEdgeIndex);
+    WriteRagged(outfile, this->B2EGroup);
+    WriteRagged(outfile, this->I2EColor);
+    WriteRagged(outfile, this->B2EColor);
+    outfile.close();
+    if (!outfile || rename(temp_filename.c_str(), filename.c_str()) != 0)
+    {
+        cout << "Cannot write the mesh cache " << filename << endl;
+        remove(temp_filename.c_str());
+    }
+}
+
+bool TriMesh::ReadBinary(string& filename, unsigned long long source_hash, int order_geo)
+{
+    // Returns false, leaving the mesh untouched, if the file is missing, of another format version,
+    // made from another .gri or order_geo, or truncated
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    size_t file_size = file_stat.st_size;
+    void* map = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    const char* data = static_cast<const char*>(map);
+    BinaryCursor cursor = {data, data + file_size, true};
+    size_t header_size = sizeof(binary_magic) + sizeof(binary_version) + sizeof(source_hash) + sizeof(order_geo);
+    int version = 0, file_order_geo = 0;
+    unsigned long long file_hash = 0;
+    if (file_size >= header_size && memcmp(data, binary_magic, sizeof(binary_magic)) == 0)
+    {
+        const char* header = data + sizeof(binary_magic);
+        memcpy(&version, header, sizeof(version)); header += sizeof(version);
+        memcpy(&file_hash, header, sizeof(file_hash)); header += sizeof(file_hash);
+        memcpy(&file_order_geo, header, sizeof(file_order_geo));
+        cursor.position = data + header_size;
+    }
+    if (version != binary_version || file_hash != source_hash || file_order_geo != order_geo)
+    {
+        munmap(map, file_size);
+        return false;
+    }
+    TriMesh mesh;
+    vector<double> scalars;
+    ReadArray(cursor, scalars);
+    ReadArray(cursor, mesh.E.offset);
+    ReadArray(cursor, mesh.E.node);
+    ReadArray(cursor, mesh.V.x);
+    ReadArray(cursor, mesh.V.y);
+    vector<unsigned long long> B_count;
+    vector<vector<int> > B_flat;
+    ReadArray(cursor, B_count);
+    ReadRagged(cursor, B_flat);
+    ReadArray(cursor, mesh.Area);
+    ReadStrings(cursor, mesh.Bname);
+    ReadStrings(cursor, mesh.name_base);
+    ReadArray(cursor, mesh.n_base);
+    ReadArray(cursor, mesh.I2E.elemL); ReadArray(cursor, mesh.I2E.locL);
+    ReadArray(cursor, mesh.I2E.elemR); ReadArray(cursor, mesh.I2E.locR);
+    ReadRagged(cursor, mesh.I2EClass);
+    ReadArray(cursor, mesh.B2E.elemL); ReadArray(cursor, mesh.B2E.locL); ReadArray(cursor, mesh.B2E.group);
+    ReadArray(cursor, mesh.In.nx); ReadArray(cursor, mesh.In.ny); ReadArray(cursor, mesh.In.len);
+    ReadArray(cursor, mesh.Bn.nx); ReadArray(cursor, mesh.Bn.ny); ReadArray(cursor, mesh.Bn.len);
+    ReadArray(cursor, mesh.Bn.curved);
+    vector<char> is_curved;
+    ReadArray(cursor, is_curved);
+    ReadArray(cursor, mesh.CurvedElementIndex);
+    ReadArray(cursor, mesh.LinearElementIndex);
+    ReadArray(cursor, mesh.CurvedEdgeIndex);
+    ReadArray(cursor, mesh.LinearEdgeIndex);
+    ReadRagged(cursor, mesh.B2EGroup);
+    ReadRagged(cursor, mesh.I2EColor);
+    ReadRagged(cursor, mesh.B2EColor);
+    munmap(map, file_size);
+    unsigned long long num_boundary_edge = 0;
+    for (size_t ibg = 0; ibg < B_count.size(); ibg++)
+        num_boundary_edge += B_count[ibg];
+    size_t num_interior_edge = mesh.I2E.elemL.size();
+    size_t num_bedge = mesh.B2E.elemL.size();
+    bool consistent = mesh.V.x.size() == mesh.V.y.size() && !mesh.E.offset.empty()
+                   && size_t(mesh.E.offset.back()) == mesh.E.node.size()
+                   && mesh.I2E.locL.size() == num_interior_edge && mesh.I2E.elemR.size() == num_interior_edge
+                   && mesh.I2E.locR.size() == num_interior_edge && mesh.In.nx.size() == num_interior_edge
+                   && mesh.In.ny.size() == num_interior_edge && mesh.In.len.size() == num_interior_edge
+                   && mesh.B2E.locL.size() == num_bedge && mesh.B2E.group.size() == num_bedge
+                   && mesh.Bn.nx.size() == num_bedge && mesh.Bn.ny.size() == num_bedge
+                   && mesh.Bn.len.size() == num_bedge && mesh.Bn.curved.size() == num_bedge;
+    if (!cursor.ok || !consistent || scalars.size() != 4 || num_boundary_edge != B_flat.size())
+        return false;
+
+    mesh.num_node = scalars[0];
+    mesh.num_element = int(scalars[1]);
+    mesh.num_boundary = scalars[2];
+    mesh.curved_group = int(scalars[3]);
+    mesh.B.resize(B_count.size());
+    size_t ib_flat = 0;
+    for (size_t ibg = 0; ibg < B_count.size(); ibg++)
+    {
+        mesh.B[ibg].assign(B_flat.begin() + ib_flat, B_flat.begin() + ib_flat + B_count[ibg]);
+        ib_flat += B_count[ibg];
+    }
+    mesh.isCurved.assign(is_curved.begin(), is_curved.end());
+    mesh.gri_filename = this->gri_filename;
+    *this = std::move(mesh);
+    return true;
+}
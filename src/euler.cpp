@@ -4,7 +4,7 @@ namespace ublas = boost::numeric::ublas;
 
 namespace euler{
 
-    ublas::matrix<double> CalcAnalyticalFlux(ublas::vector<double> state, double gamma)
+    ublas::matrix<double> CalcAnalyticalFlux(const ublas::vector<double>& state, double gamma)
     {
         /*
             The function caculating the analytical flux from the state vector
@@ -32,89 +32,38 @@ namespace euler{
         return F;
     }
 
-    ublas::vector<double> CalcNumericalFlux(ublas::vector<double> uL, ublas::vector<double> uR, ublas::vector<double> n,
-                                            double gamma, char* type_flux, double& mws)
+    void CalcAnalyticalFlux(const double* state, double gamma, double* F)
+    {
+        /*
+            Same as above, but writes the 4 x 2 flux row-major into F,
+            so the volume kernels can call it without allocating
+        */
+        double rho = state[0];
+        double u = state[1] / rho;
+        double v = state[2] / rho;
+        double E = state[3] / rho;
+        double q = sqrt(u * u + v * v);
+        double p = (gamma - 1) * (rho * E - 0.5 * rho * q * q);
+        if (p < 0)
+        {
+            std::cout << "Negative Presure!!!" << std::endl;
+            abort();
+        }
+        double H = E + p / rho;
+        F[0] = rho * u;         F[1] = rho * v;
+        F[2] = rho * u * u + p; F[3] = rho * v * u;
+        F[4] = rho * u * v;     F[5] = rho * v * v + p;
+        F[6] = rho * u * H;     F[7] = rho * v * H;
+    }
+
+    ublas::vector<double> CalcNumericalFlux(const ublas::vector<double>& uL, const ublas::vector<double>& uR, const ublas::vector<double>& n,
+                                            double gamma, const char* type_flux, double& mws)
     {
         if (strcasecmp(type_flux, "roe") == 0)
         {
             ublas::vector<double> F_hat(4, 0.0);
-
-            double v_roe_vec[2]; double u_roe;
-            double H_roe, c_roe, q_roe;
-            double pL, pR, HL, HR, cL, cR, rhoL, rhoR, qL, qR;
-            double lambda_1, lambda_2, lambda_3;
-            double s1, s2, G1, G2, C1, C2;
-
-            double drho, drhoE, drhov_vec[2];
-
-            //Primitive variables
-            rhoL = uL[0];
-            rhoR = uR[0];
-            pL = (gamma - 1) * (uL[3] - 0.5 * (uL[1]*uL[1] + uL[2]*uL[2]) / uL[0]);
-            HL = uL[3] / uL[0] + pL / uL[0];
-            pR = (gamma - 1) * (uR[3] - 0.5 * (uR[1]*uR[1] + uR[2]*uR[2]) / uR[0]);
-
-            HR = uR[3] / uR[0] + pR / uR[0];
-            cL = sqrt(gamma * pL / rhoL);
-            cR = sqrt(gamma * pR / rhoR);
-            qL = sqrt(pow(uL[1] / uL[0], 2) + pow(uL[2] / uL[0], 2));
-            qR = sqrt(pow(uR[1] / uR[0], 2) + pow(uR[2] / uR[0], 2));
-            // calculate v_roe
-            v_roe_vec[0] = (sqrt(rhoL) * (uL[1] / uL[0]) + sqrt(rhoR) * (uR[1] / uR[0])) / (sqrt(rhoL) + sqrt(rhoR));
-            v_roe_vec[1] = (sqrt(rhoL) * (uL[2] / uL[0]) + sqrt(rhoR) * (uR[2] / uR[0])) / (sqrt(rhoL) + sqrt(rhoR));
-            u_roe = v_roe_vec[0] * n[0] + v_roe_vec[1] * n[1];
-            // calculate H_roe
-            H_roe = (sqrt(rhoL) * HL + sqrt(rhoR) * HR) / (sqrt(rhoL) + sqrt(rhoR));
-
-            // velocity magnitude
-            q_roe = sqrt(v_roe_vec[0] * v_roe_vec[0] + v_roe_vec[1] * v_roe_vec[1]);
-            // sound speed
-            c_roe = sqrt((gamma - 1.0) * (H_roe - 0.5 * (v_roe_vec[0] * v_roe_vec[0] + v_roe_vec[1] * v_roe_vec[1])));
-            // eigenvalues
-            double lambda[3];
-            lambda[0] = u_roe + c_roe;
-            lambda[1] = u_roe - c_roe;
-            lambda[2] = u_roe;
-
-            // entropy fix for lambda_1, lambda_2 and lambda_3
-            double epsilon = 0.1 * c_roe;
-            int i;
-            for (i = 0; i < 3; i++){
-                if (lambda[i] < epsilon && lambda[i] > -epsilon){
-                lambda[i] = 0.5 * (epsilon + lambda[i] * lambda[i] / epsilon);
-                }
-            }
-            lambda_1 = lambda[0]; lambda_2 = lambda[1]; lambda_3 = lambda[2];
-
-            // calculate the delta quantities for roe flux
-            drho = uR[0] - uL[0];
-            drhoE = uR[3] - uL[3];
-            drhov_vec[0] = uR[1] - uL[1];
-            drhov_vec[1] = uR[2] - uL[2];
-            // temporary vars for calculating the Roe Flux
-            s1 = 0.5*(fabs(lambda_1) + fabs(lambda_2));
-            s2 = 0.5*(fabs(lambda_1) - fabs(lambda_2));
-            G1 = (gamma - 1.0) * (q_roe * q_roe * drho / 2 + drhoE - (v_roe_vec[0] * drhov_vec[0] + v_roe_vec[1] * drhov_vec[1]));
-            G2 = -1.0 * u_roe * drho + (drhov_vec[0] * n[0] + drhov_vec[1] * n[1]);
-            C1 = G1 * (s1 - fabs(lambda_3)) / pow(c_roe, 2) + G2 * s2 / c_roe;
-            C2 = G1 * s2 / c_roe + (s1 - fabs(lambda_3)) * G2;
-
-            ublas::matrix<double> FL = CalcAnalyticalFlux(uL, gamma);
-            ublas::matrix<double> FR = CalcAnalyticalFlux(uR, gamma);
-
-            ublas::vector<double> FL_hat(4, 0.0), FR_hat(4, 0.0);
-            ublas::axpy_prod(FL, n, FL_hat, false);
-            ublas::axpy_prod(FR, n, FR_hat, false);
-
-            F_hat[0] = 0.5 * (FL_hat[0] + FR_hat[0]) - 0.5 * (fabs(lambda_3) * drho + C1);
-            F_hat[1] = 0.5 * (FL_hat[1] + FR_hat[1]) - 0.5 * (fabs(lambda_3) * drhov_vec[0] + C1 * v_roe_vec[0] + C2 * n[0]);
-            F_hat[2] = 0.5 * (FL_hat[2] + FR_hat[2]) - 0.5 * (fabs(lambda_3) * drhov_vec[1] + C1 * v_roe_vec[1] + C2 * n[1]);
-            F_hat[3] = 0.5 * (FL_hat[3] + FR_hat[3]) - 0.5 * (fabs(lambda_3) * drhoE + C1 * H_roe + C2 * u_roe);
-
-            mws = fabs(u_roe) + c_roe;
-
+            CalcRoeFlux(&uL(0), &uR(0), &n(0), gamma, &F_hat(0), mws);
             return F_hat;
-
         }
         else
         {
@@ -124,105 +73,339 @@ namespace euler{
 
     }
 
-    ublas::vector<double> ApplyBoundaryCondition(ublas::vector<double> u, ublas::vector<double> norm,  std::string boundary_type, Param& cparam, double &mws)
+    void CalcRoeFlux(const double* uL, const double* uR, const double* n, double gamma, double* F_hat, double& mws)
     {
-        ublas::vector<double> num_flux(u.size(), 0.0);
-        num_flux.clear();
+        /*
+            Same as the roe branch of CalcNumericalFlux, but on raw arrays,
+            so the face kernels can call it without allocating
+        */
+        double v_roe_vec[2]; double u_roe;
+        double H_roe, c_roe, q_roe;
+        double pL, pR, HL, HR, rhoL, rhoR;
+        double lambda_1, lambda_2, lambda_3;
+        double s1, s2, G1, G2, C1, C2;
+
+        double drho, drhoE, drhov_vec[2];
+
+        //Primitive variables
+        rhoL = uL[0];
+        rhoR = uR[0];
+        pL = (gamma - 1) * (uL[3] - 0.5 * (uL[1]*uL[1] + uL[2]*uL[2]) / uL[0]);
+        HL = uL[3] / uL[0] + pL / uL[0];
+        pR = (gamma - 1) * (uR[3] - 0.5 * (uR[1]*uR[1] + uR[2]*uR[2]) / uR[0]);
+        HR = uR[3] / uR[0] + pR / uR[0];
+        // calculate v_roe
+        v_roe_vec[0] = (sqrt(rhoL) * (uL[1] / uL[0]) + sqrt(rhoR) * (uR[1] / uR[0])) / (sqrt(rhoL) + sqrt(rhoR));
+        v_roe_vec[1] = (sqrt(rhoL) * (uL[2] / uL[0]) + sqrt(rhoR) * (uR[2] / uR[0])) / (sqrt(rhoL) + sqrt(rhoR));
+        u_roe = v_roe_vec[0] * n[0] + v_roe_vec[1] * n[1];
+        // calculate H_roe
+        H_roe = (sqrt(rhoL) * HL + sqrt(rhoR) * HR) / (sqrt(rhoL) + sqrt(rhoR));
+
+        // velocity magnitude
+        q_roe = sqrt(v_roe_vec[0] * v_roe_vec[0] + v_roe_vec[1] * v_roe_vec[1]);
+        // sound speed
+        c_roe = sqrt((gamma - 1.0) * (H_roe - 0.5 * (v_roe_vec[0] * v_roe_vec[0] + v_roe_vec[1] * v_roe_vec[1])));
+        // eigenvalues
+        double lambda[3];
+        lambda[0] = u_roe + c_roe;
+        lambda[1] = u_roe - c_roe;
+        lambda[2] = u_roe;
+
+        // entropy fix for lambda_1, lambda_2 and lambda_3
+        double epsilon = 0.1 * c_roe;
+        for (int i = 0; i < 3; i++){
+            if (lambda[i] < epsilon && lambda[i] > -epsilon){
+            lambda[i] = 0.5 * (epsilon + lambda[i] * lambda[i] / epsilon);
+            }
+        }
+        lambda_1 = lambda[0]; lambda_2 = lambda[1]; lambda_3 = lambda[2];
+
+        // calculate the delta quantities for roe flux
+        drho = uR[0] - uL[0];
+        drhoE = uR[3] - uL[3];
+        drhov_vec[0] = uR[1] - uL[1];
+        drhov_vec[1] = uR[2] - uL[2];
+        // temporary vars for calculating the Roe Flux
+        s1 = 0.5*(fabs(lambda_1) + fabs(lambda_2));
+        s2 = 0.5*(fabs(lambda_1) - fabs(lambda_2));
+        G1 = (gamma - 1.0) * (q_roe * q_roe * drho / 2 + drhoE - (v_roe_vec[0] * drhov_vec[0] + v_roe_vec[1] * drhov_vec[1]));
+        G2 = -1.0 * u_roe * drho + (drhov_vec[0] * n[0] + drhov_vec[1] * n[1]);
+        C1 = G1 * (s1 - fabs(lambda_3)) / pow(c_roe, 2) + G2 * s2 / c_roe;
+        C2 = G1 * s2 / c_roe + (s1 - fabs(lambda_3)) * G2;
+
+        double FL[8], FR[8];
+        CalcAnalyticalFlux(uL, gamma, FL);
+        CalcAnalyticalFlux(uR, gamma, FR);
+        double FL_hat[4], FR_hat[4];
+        for (int i = 0; i < 4; i++)
+        {
+            FL_hat[i] = FL[i * 2] * n[0] + FL[i * 2 + 1] * n[1];
+            FR_hat[i] = FR[i * 2] * n[0] + FR[i * 2 + 1] * n[1];
+        }
 
-        if (strcasecmp(boundary_type.c_str(), "Inflow") == 0){
-            double p = (cparam.gamma - 1.0) * (u[3] - 0.5 * (u[1]*u[1] + u[2]*u[2]) / u[0]);
-            double un = (u[1] / u[0]) * norm[0] + (u[2] / u[0]) * norm[1];
-            double c = sqrt(cparam.gamma * p / u[0]);
-            double J = un + 2.0 * c / (cparam.gamma - 1); // Riemann Invariant
-            double dn = cos(cparam.attack_angle)*norm[0] + sin(cparam.attack_angle)*norm[1];
-            double R = 1.0;
+        F_hat[0] = 0.5 * (FL_hat[0] + FR_hat[0]) - 0.5 * (fabs(lambda_3) * drho + C1);
+        F_hat[1] = 0.5 * (FL_hat[1] + FR_hat[1]) - 0.5 * (fabs(lambda_3) * drhov_vec[0] + C1 * v_roe_vec[0] + C2 * n[0]);
+        F_hat[2] = 0.5 * (FL_hat[2] + FR_hat[2]) - 0.5 * (fabs(lambda_3) * drhov_vec[1] + C1 * v_roe_vec[1] + C2 * n[1]);
+        F_hat[3] = 0.5 * (FL_hat[3] + FR_hat[3]) - 0.5 * (fabs(lambda_3) * drhoE + C1 * H_roe + C2 * u_roe);
 
-            double Tt = 1.0 + 0.5 * (cparam.gamma - 1) * cparam.mach_inf * cparam.mach_inf;
-            double pt = pow(Tt, cparam.gamma / (cparam.gamma - 1.0));
+        mws = fabs(u_roe) + c_roe;
+    }
+
+    void CalcAnalyticalFluxBatch(int n, const double* U, int ld_U, double gamma, double* F, int ld_F)
+    {
+        double p_min = std::numeric_limits<double>::max();
+        #pragma omp simd reduction(min:p_min)
+        for (int i = 0; i < n; i++)
+        {
+            double rho = U[i], rhou = U[ld_U + i], rhov = U[2 * ld_U + i], rhoE = U[3 * ld_U + i];
+            double u = rhou / rho;
+            double v = rhov / rho;
+            double p = (gamma - 1) * (rhoE - 0.5 * (rhou * u + rhov * v));
+            double H = (rhoE + p) / rho;
+            F[0 * ld_F + i] = rhou;         F[1 * ld_F + i] = rhov;
+            F[2 * ld_F + i] = rhou * u + p; F[3 * ld_F + i] = rhov * u;
+            F[4 * ld_F + i] = rhou * v;     F[5 * ld_F + i] = rhov * v + p;
+            F[6 * ld_F + i] = rhou * H;     F[7 * ld_F + i] = rhov * H;
+            p_min = std::min(p_min, p);
+        }
+        // checked once per batch, so that the loop above stays branch free
+        if (p_min < 0)
+        {
+            std::cout << "Negative Presure!!!" << std::endl;
+            abort();
+        }
+    }
 
+    void CalcRoeFluxBatch(int n, const double* UL, const double* UR, int ld_U, const double* nx, const double* ny,
+                          double gamma, double* F_hat, int ld_F, double* mws)
+    {
+        double p_min = std::numeric_limits<double>::max();
+        #pragma omp simd reduction(min:p_min)
+        for (int i = 0; i < n; i++)
+        {
+            double rhoL = UL[i], rhouL = UL[ld_U + i], rhovL = UL[2 * ld_U + i], rhoEL = UL[3 * ld_U + i];
+            double rhoR = UR[i], rhouR = UR[ld_U + i], rhovR = UR[2 * ld_U + i], rhoER = UR[3 * ld_U + i];
+            double n0 = nx[i], n1 = ny[i];
+            //Primitive variables
+            double uL = rhouL / rhoL, vL = rhovL / rhoL;
+            double uR = rhouR / rhoR, vR = rhovR / rhoR;
+            double pL = (gamma - 1) * (rhoEL - 0.5 * (rhouL * uL + rhovL * vL));
+            double pR = (gamma - 1) * (rhoER - 0.5 * (rhouR * uR + rhovR * vR));
+            double HL = (rhoEL + pL) / rhoL;
+            double HR = (rhoER + pR) / rhoR;
+            // Roe averages
+            double sqrt_rhoL = sqrt(rhoL), sqrt_rhoR = sqrt(rhoR);
+            double inv_sum = 1.0 / (sqrt_rhoL + sqrt_rhoR);
+            double v_roe_0 = (sqrt_rhoL * uL + sqrt_rhoR * uR) * inv_sum;
+            double v_roe_1 = (sqrt_rhoL * vL + sqrt_rhoR * vR) * inv_sum;
+            double H_roe = (sqrt_rhoL * HL + sqrt_rhoR * HR) * inv_sum;
+            double u_roe = v_roe_0 * n0 + v_roe_1 * n1;
+            double q2_roe = v_roe_0 * v_roe_0 + v_roe_1 * v_roe_1;
+            double c_roe = sqrt((gamma - 1.0) * (H_roe - 0.5 * q2_roe));
+            // eigenvalues with the entropy fix
+            double epsilon = 0.1 * c_roe;
+            double lambda_1 = u_roe + c_roe, lambda_2 = u_roe - c_roe, lambda_3 = u_roe;
+            lambda_1 = fabs(lambda_1) < epsilon ? 0.5 * (epsilon + lambda_1 * lambda_1 / epsilon) : lambda_1;
+            lambda_2 = fabs(lambda_2) < epsilon ? 0.5 * (epsilon + lambda_2 * lambda_2 / epsilon) : lambda_2;
+            lambda_3 = fabs(lambda_3) < epsilon ? 0.5 * (epsilon + lambda_3 * lambda_3 / epsilon) : lambda_3;
+            double abs_lambda_3 = fabs(lambda_3);
+            // calculate the delta quantities for roe flux
+            double drho = rhoR - rhoL;
+            double drhoE = rhoER - rhoEL;
+            double drhou = rhouR - rhouL;
+            double drhov = rhovR - rhovL;
+            double s1 = 0.5 * (fabs(lambda_1) + fabs(lambda_2));
+            double s2 = 0.5 * (fabs(lambda_1) - fabs(lambda_2));
+            double G1 = (gamma - 1.0) * (q2_roe * drho / 2 + drhoE - (v_roe_0 * drhou + v_roe_1 * drhov));
+            double G2 = -1.0 * u_roe * drho + (drhou * n0 + drhov * n1);
+            double inv_c = 1.0 / c_roe;
+            double C1 = G1 * (s1 - abs_lambda_3) * inv_c * inv_c + G2 * s2 * inv_c;
+            double C2 = G1 * s2 * inv_c + (s1 - abs_lambda_3) * G2;
+            // normal analytical fluxes of both sides
+            double unL = uL * n0 + vL * n1;
+            double unR = uR * n0 + vR * n1;
+            F_hat[i] = 0.5 * (rhoL * unL + rhoR * unR) - 0.5 * (abs_lambda_3 * drho + C1);
+            F_hat[ld_F + i] = 0.5 * (rhouL * unL + pL * n0 + rhouR * unR + pR * n0) - 0.5 * (abs_lambda_3 * drhou + C1 * v_roe_0 + C2 * n0);
+            F_hat[2 * ld_F + i] = 0.5 * (rhovL * unL + pL * n1 + rhovR * unR + pR * n1) - 0.5 * (abs_lambda_3 * drhov + C1 * v_roe_1 + C2 * n1);
+            F_hat[3 * ld_F + i] = 0.5 * (rhoL * HL * unL + rhoR * HR * unR) - 0.5 * (abs_lambda_3 * drhoE + C1 * H_roe + C2 * u_roe);
+            mws[i] = fabs(u_roe) + c_roe;
+            p_min = std::min(p_min, std::min(pL, pR));
+        }
+        if (p_min < 0)
+        {
+            std::cout << "Negative Presure!!!" << std::endl;
+            abort();
+        }
+    }
+
+    void InflowKernel(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                      double* F, int ld_F, double* mws)
+    {
+        double gamma = bc.gamma, R = bc.R, Tt = bc.Tt, pt = bc.pt;
+        double exponent = gamma / (gamma - 1.0);
+        #pragma omp simd
+        for (int i = 0; i < n; i++)
+        {
+            double rho = U[i], rhou = U[ld_U + i], rhov = U[2 * ld_U + i], rhoE = U[3 * ld_U + i];
+            double n0 = nx[i], n1 = ny[i];
+            double p = (gamma - 1.0) * (rhoE - 0.5 * (rhou * rhou + rhov * rhov) / rho);
+            double un = (rhou / rho) * n0 + (rhov / rho) * n1;
+            double c = sqrt(gamma * p / rho);
+            double J = un + 2.0 * c / (gamma - 1); // Riemann Invariant
+            double dn = bc.dir[0] * n0 + bc.dir[1] * n1;
             // Solve for Mb
             // ca, cb, cc are coefficients for quadratic equation
-            double tmpa = cparam.gamma * R * Tt * dn * dn - 0.5 * (cparam.gamma - 1.0) * J * J;
-            double tmpb = 4.0 * cparam.gamma * R * Tt * dn / (cparam.gamma - 1.0);
-            double tmpc = 4.0 * cparam.gamma * R * Tt  / pow((cparam.gamma - 1.0), 2) - J * J;
-            double Mb1 = (-1.0 * tmpb - sqrt(tmpb * tmpb - 4.0 * tmpa * tmpc)) / (2 * tmpa);
-            double Mb2 = (-1.0 * tmpb + sqrt(tmpb * tmpb - 4.0 * tmpa * tmpc)) / (2 * tmpa);
-            double Mb;
-            if (Mb1 < 0)
-                Mb = Mb2;
-            else
-                Mb = Mb1;
+            double tmpa = gamma * R * Tt * dn * dn - 0.5 * (gamma - 1.0) * J * J;
+            double tmpb = 4.0 * gamma * R * Tt * dn / (gamma - 1.0);
+            double tmpc = 4.0 * gamma * R * Tt / ((gamma - 1.0) * (gamma - 1.0)) - J * J;
+            double sqrt_disc = sqrt(tmpb * tmpb - 4.0 * tmpa * tmpc);
+            double Mb1 = (-1.0 * tmpb - sqrt_disc) / (2 * tmpa);
+            double Mb2 = (-1.0 * tmpb + sqrt_disc) / (2 * tmpa);
+            double Mb = Mb1 < 0 ? Mb2 : Mb1;
             // Calculate the exterior states
-            double Tb = Tt / (1.0 + 0.5*(cparam.gamma - 1.0) * Mb * Mb);
-            double pb = pt * pow(Tb / Tt, cparam.gamma / (cparam.gamma - 1.0));
+            double Tb = Tt / (1.0 + 0.5 * (gamma - 1.0) * Mb * Mb);
+            double pb = pt * pow(Tb / Tt, exponent);
             double rhob = pb / (R * Tb);
-            double cb = sqrt(cparam.gamma * pb / rhob);
-            double vb[2] = {Mb * cb * cos(cparam.attack_angle), Mb * cb * sin(cparam.attack_angle)};
-            double rhoEb = pb / (cparam.gamma - 1.0) + 0.5 * rhob * (vb[0] * vb[0] + vb[1] * vb[1]);
-            ublas::vector<double> ub(4, 0.0);
-            ub(0) = rhob;         ub(1) = rhob * vb[0];
-            ub(2) = rhob * vb[1]; ub(3) = rhoEb;
-            ublas::matrix<double> F_b = CalcAnalyticalFlux(ub, cparam.gamma);
-            ublas::axpy_prod(F_b, norm, num_flux, false);
+            double cb = sqrt(gamma * pb / rhob);
+            double vb0 = Mb * cb * bc.dir[0], vb1 = Mb * cb * bc.dir[1];
+            double rhoEb = pb / (gamma - 1.0) + 0.5 * rhob * (vb0 * vb0 + vb1 * vb1);
+            double ubn = vb0 * n0 + vb1 * n1;
+            F[i] = rhob * ubn;
+            F[ld_F + i] = rhob * vb0 * ubn + pb * n0;
+            F[2 * ld_F + i] = rhob * vb1 * ubn + pb * n1;
+            F[3 * ld_F + i] = (rhoEb + pb) * ubn;
             // Max Wave Speed
-            mws = fabs(vb[0] * norm[0] + vb[1] * norm[1]) + cb;
-
-        } else if (strcasecmp(boundary_type.c_str(), "Inviscid_Wall") == 0){
-
-            double vb[2];
-
-            vb[0] = u[1] / u[0] - ((u[1] / u[0]) * norm[0] + (u[2] / u[0]) * norm[1]) * norm[0];
-            vb[1] = u[2] / u[0] - ((u[1] / u[0]) * norm[0] + (u[2] / u[0]) * norm[1]) * norm[1];
-
-            double pb = (cparam.gamma - 1.0) * (u[3] - 0.5 * u[0] * (vb[0] * vb[0] + vb[1] * vb[1]));
-
-            num_flux[0] = 0.0;
-            num_flux[1] = norm[0] * pb;
-            num_flux[2] = norm[1] * pb;
-            num_flux[3] = 0.0;
-
-            double p = (cparam.gamma - 1.0) * (u[3] - 0.5 * (u[1]*u[1] + u[2]*u[2]) / u[0]);
-            mws = sqrt(pow(u[1] / u[0], 2) + pow(u[2] / u[0], 2)) + sqrt(cparam.gamma * p / u[0]);
+            mws[i] = fabs(ubn) + cb;
+        }
+    }
 
-        } else if (strcasecmp(boundary_type.c_str(), "Subsonic_Outflow") == 0){
+    void InviscidWallKernel(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                            double* F, int ld_F, double* mws)
+    {
+        double gamma = bc.gamma;
+        #pragma omp simd
+        for (int i = 0; i < n; i++)
+        {
+            double rho = U[i], rhou = U[ld_U + i], rhov = U[2 * ld_U + i], rhoE = U[3 * ld_U + i];
+            double n0 = nx[i], n1 = ny[i];
+            double u = rhou / rho, v = rhov / rho;
+            double un = u * n0 + v * n1;
+            double vb0 = u - un * n0;
+            double vb1 = v - un * n1;
+            double pb = (gamma - 1.0) * (rhoE - 0.5 * rho * (vb0 * vb0 + vb1 * vb1));
+            F[i] = 0.0;
+            F[ld_F + i] = n0 * pb;
+            F[2 * ld_F + i] = n1 * pb;
+            F[3 * ld_F + i] = 0.0;
+            double p = (gamma - 1.0) * (rhoE - 0.5 * (rhou * rhou + rhov * rhov) / rho);
+            mws[i] = sqrt(u * u + v * v) + sqrt(gamma * p / rho);
+        }
+    }
 
+    void SubsonicOutflowKernel(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                               double* F, int ld_F, double* mws)
+    {
+        double gamma = bc.gamma, pb = bc.p_b;
+        double inv_gamma = 1.0 / gamma;
+        #pragma omp simd
+        for (int i = 0; i < n; i++)
+        {
+            double rho = U[i], rhou = U[ld_U + i], rhov = U[2 * ld_U + i], rhoE = U[3 * ld_U + i];
+            double n0 = nx[i], n1 = ny[i];
             /* Interior entropy*/
-            double p = (cparam.gamma - 1.0) * (u[3] - 0.5 * (u[1]*u[1] + u[2]*u[2]) / u[0]);
-            double S = p / pow(u[0], cparam.gamma);
-            double pb = cparam.p_inf;
-            double rhob = pow(pb / S,  1.0 / cparam.gamma);
-            double cb = sqrt(cparam.gamma * pb / rhob);
-            double un = (u[1] / u[0]) * norm[0] + (u[2] / u[0]) * norm[1];
-
-            double c = sqrt(cparam.gamma * p / u[0]);
-            double J = un + 2.0 * c / (cparam.gamma - 1.0); // Riemann Invariant
-
-            double ub_n = J - 2.0 * cb / (cparam.gamma - 1.0);
-
+            double p = (gamma - 1.0) * (rhoE - 0.5 * (rhou * rhou + rhov * rhov) / rho);
+            double S = p / pow(rho, gamma);
+            double rhob = pow(pb / S, inv_gamma);
+            double cb = sqrt(gamma * pb / rhob);
+            double u = rhou / rho, v = rhov / rho;
+            double un = u * n0 + v * n1;
+            double c = sqrt(gamma * p / rho);
+            double J = un + 2.0 * c / (gamma - 1.0); // Riemann Invariant
+            double ub_n = J - 2.0 * cb / (gamma - 1.0);
             /* Solve for vb*/
-            double vb[2] = {0.0, 0.0};
-            vb[0] = u[1] / u[0] - norm[0] * (u[1]*norm[0] + u[2]*norm[1]) / u[0] + ub_n * norm[0];
-            vb[1] = u[2] / u[0] - norm[1] * (u[1]*norm[0] + u[2]*norm[1]) / u[0] + ub_n * norm[1];
-
-            double rhoEb = pb / (cparam.gamma - 1.0) + 0.5 * rhob * (vb[0] * vb[0] + vb[1] * vb[1]);
+            double vb0 = u - n0 * un + ub_n * n0;
+            double vb1 = v - n1 * un + ub_n * n1;
+            double rhoEb = pb / (gamma - 1.0) + 0.5 * rhob * (vb0 * vb0 + vb1 * vb1);
+            double vbn = vb0 * n0 + vb1 * n1;
+            F[i] = rhob * vbn;
+            F[ld_F + i] = rhob * vb0 * vbn + pb * n0;
+            F[2 * ld_F + i] = rhob * vb1 * vbn + pb * n1;
+            F[3 * ld_F + i] = (rhoEb + pb) * vbn;
+            mws[i] = sqrt(vb0 * vb0 + vb1 * vb1) + cb;
+        }
+    }
 
-            ublas::vector<double> ub(4, 0.0);
-            ub(0) = rhob;         ub(1) = rhob * vb[0];
-            ub(2) = rhob * vb[1]; ub(3) = rhoEb;
-            ublas::matrix<double> F_b = CalcAnalyticalFlux(ub, cparam.gamma);
-            ublas::axpy_prod(F_b, norm, num_flux, false); // num_flux is passed out
+    void FreeStreamKernel(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                          double* F, int ld_F, double* mws)
+    {
+        // Roe flux against the precomputed free stream state
+        static thread_local std::vector<double> U_free;
+        U_free.resize(4 * n);
+        for (int istate = 0; istate < 4; istate++)
+        {
+            std::fill(U_free.begin() + istate * n, U_free.begin() + (istate + 1) * n, bc.u_free[istate]);
+        }
+        if (ld_U != n)
+        {
+            // CalcRoeFluxBatch takes one leading dimension for both sides
+            static thread_local std::vector<double> U_inside;
+            U_inside.resize(4 * n);
+            for (int istate = 0; istate < 4; istate++)
+            {
+                std::copy(U + istate * ld_U, U + istate * ld_U + n, U_inside.begin() + istate * n);
+            }
+            CalcRoeFluxBatch(n, U_inside.data(), U_free.data(), n, nx, ny, bc.gamma, F, ld_F, mws);
+            return;
+        }
+        CalcRoeFluxBatch(n, U, U_free.data(), n, nx, ny, bc.gamma, F, ld_F, mws);
+    }
 
-            mws = sqrt(pow(ub[1] / ub[0], 2) + pow(ub[2] / ub[0], 2)) + sqrt(cparam.gamma * pb / ub[0]);
+    const BoundaryKernel boundary_kernels[num_boundary_type] = {&InflowKernel, &InviscidWallKernel, &SubsonicOutflowKernel, &FreeStreamKernel};
 
+    BoundaryCondition SetupBoundaryCondition(const std::string& boundary_type, Param& param)
+    {
+        BoundaryCondition bc;
+        if (strcasecmp(boundary_type.c_str(), "Inflow") == 0){
+            bc.type = Inflow;
+        } else if (strcasecmp(boundary_type.c_str(), "Inviscid_Wall") == 0){
+            bc.type = Inviscid_Wall;
+        } else if (strcasecmp(boundary_type.c_str(), "Subsonic_Outflow") == 0){
+            bc.type = Subsonic_Outflow;
         } else if (strcasecmp(boundary_type.c_str(), "Free_Stream") == 0){
-            double mws_temp;
-            ublas::vector<double> u_free = CalcFreeStreamState_2DEuler(cparam);
-            num_flux = CalcNumericalFlux(u, u_free, norm, cparam.gamma, "roe", mws_temp);
-            mws = mws_temp;
+            bc.type = Free_Stream;
         } else{
             std::cout << "ERROR: Unknown Boundary Condition: " << boundary_type << std::endl;
             abort();
         }
+        bc.kernel = boundary_kernels[bc.type];
+        bc.gamma = param.gamma;
+        bc.p_b = param.p_inf;
+        // Total conditions of the inflow
+        bc.R = 1.0;
+        bc.Tt = 1.0 + 0.5 * (param.gamma - 1) * param.mach_inf * param.mach_inf;
+        bc.pt = pow(bc.Tt, param.gamma / (param.gamma - 1.0));
+        bc.dir[0] = cos(param.attack_angle);
+        bc.dir[1] = sin(param.attack_angle);
+        ublas::vector<double> u_free = CalcFreeStreamState_2DEuler(param);
+        for (int istate = 0; istate < 4; istate++)
+        {
+            bc.u_free[istate] = u_free(istate);
+        }
+        return bc;
+    }
+
+    void ApplyBoundaryConditionBatch(const BoundaryCondition& bc, int n, const double* U, int ld_U, const double* nx, const double* ny,
+                                     double* F, int ld_F, double* mws)
+    {
+        bc.kernel(bc, n, U, ld_U, nx, ny, F, ld_F, mws);
+    }
+
+    ublas::vector<double> ApplyBoundaryCondition(const ublas::vector<double>& u, const ublas::vector<double>& norm,  const std::string& boundary_type, Param& cparam, double &mws)
+    {
+        // Single point version, resolves the boundary type on every call
+        BoundaryCondition bc = SetupBoundaryCondition(boundary_type, cparam);
+        ublas::vector<double> num_flux(u.size(), 0.0);
+        ApplyBoundaryConditionBatch(bc, 1, &u(0), 1, &norm(0), &norm(1), &num_flux(0), 1, &mws);
         return num_flux;
     }
 
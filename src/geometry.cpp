@@ -7,11 +7,11 @@ namespace geometry
         return 0.0625 * std::exp(-25.0 * x * x);
     }
 
-    ublas::matrix<double> CalcJacobianLinear(TriMesh mesh, int ielem)
+    ublas::matrix<double> CalcJacobianLinear(const TriMesh& mesh, int ielem)
     {
         ublas::matrix<double> jacobian (2, 2);
         ublas::matrix<double> vertex (3, 2);
-        std::vector<int> vertex_index = utils::GetVertexIndex(mesh.E[ielem]);
+        std::vector<int> vertex_index = utils::GetVertexIndex(mesh.E[ielem].size());
         for (int i = 0; i < 3; i++)
         {
             vertex(i, 0) = mesh.V[mesh.E[ielem][vertex_index[i]] - 1][0];
@@ -24,13 +24,13 @@ namespace geometry
         return jacobian;
     }
 
-    ublas::matrix<double> CalcJacobianCurved(TriMesh mesh, int ielem, boost::multi_array<double, 3> GPhi_Curved, int n_quad_2d, int ig)
+    ublas::matrix<double> CalcJacobianCurved(const TriMesh& mesh, int ielem, const boost::multi_array<double, 3>& GPhi_Curved, int n_quad_2d, int ig)
     {
         // In a curved element, the jacobian varies from the points eveluated on
         // Since GPhi on quadrature points are pre-caculated, so GPhi is passed in
         ublas::matrix<double> jacobian(2, 2, 0.0);
         // First, if this element is really a curved element?
-        std:vector<int> lagrange_nodes_index = mesh.E[ielem];
+        LegacyRow<ElementNodes, int> lagrange_nodes_index = mesh.E[ielem];
         int Np = lagrange_nodes_index.size();
         int p = int((sqrt(1 + 8.0 * Np) - 3) / 2);
         ublas::matrix<double> Nodes_Coord(Np, 2);
@@ -40,7 +40,6 @@ namespace geometry
             Nodes_Coord(i, 1) = mesh.V[lagrange_nodes_index[i] - 1][1];
         }
         ublas::matrix <double> GPhi_on_quad(Np, 2, 0.0);
-        GPhi_Curved.resize(boost::extents[n_quad_2d][Np][2]);
         for (int ip = 0; ip < Np; ip++)
         {
             GPhi_on_quad(ip, 0) = GPhi_Curved[ig][ip][0];
@@ -96,7 +95,7 @@ namespace geometry
         return selected_lagrange_index;
     }
 
-    ublas::vector<int> GetEdgeCoordinatesIndex(TriMesh mesh, int iedge)
+    ublas::vector<int> GetEdgeCoordinatesIndex(const TriMesh& mesh, int iedge)
     {
         int Nq = mesh.E[mesh.B2E[iedge][0] - 1].size();
         int q = int((sqrt(1 + 8.0 * Nq) - 3) / 2);
@@ -127,7 +126,7 @@ namespace geometry
         return edge_coord_index;
     }
 
-    ublas::vector<ublas::vector<double> > GetEdgeCoordinates(TriMesh mesh, int iedge)
+    ublas::vector<ublas::vector<double> > GetEdgeCoordinates(const TriMesh& mesh, int iedge)
     {
         // Get the geometry points on the edge
         int Nq = mesh.E[mesh.B2E[iedge][0] - 1].size();
@@ -0,0 +1,697 @@
+#include "../include/kernels.h"
+
+namespace ublas = boost::numeric::ublas;
+
+namespace kernels
+{
+
+    // Number of lagrange nodes of a triangle of order P, or the runtime value for the generic kernels (P < 0)
+    template <int P>
+    inline int NumNodes(int Np_runtime)
+    {
+        return P >= 0 ? (P + 1) * (P + 2) / 2 : Np_runtime;
+    }
+
+    // MatMul with the row count M and inner dimension K fixed at compile time, a negative value means runtime
+    template <int M, int K>
+    inline void MatMulFixed(const double* A, const double* B, double* C, int m_runtime, int k_runtime, int n, bool accumulate)
+    {
+        const int m = M >= 0 ? M : m_runtime;
+        const int k = K >= 0 ? K : k_runtime;
+        if (!accumulate)
+        {
+            for (int i = 0; i < m * n; i++)
+            {
+                C[i] = 0.0;
+            }
+        }
+        // i-k-j ordering, so that the innermost loop runs over contiguous rows of B and C
+        for (int i = 0; i < m; i++)
+        {
+            double* C_row = C + i * n;
+            for (int l = 0; l < k; l++)
+            {
+                double a = A[i * k + l];
+                const double* B_row = B + l * n;
+                for (int j = 0; j < n; j++)
+                {
+                    C_row[j] += a * B_row[j];
+                }
+            }
+        }
+    }
+
+    // MatTransMul with the row count M of the result fixed at compile time, a negative value means runtime
+    template <int M>
+    inline void MatTransMulFixed(const double* A, const double* B, double* C, int m_runtime, int k, int n, bool accumulate)
+    {
+        const int m = M >= 0 ? M : m_runtime;
+        if (!accumulate)
+        {
+            for (int i = 0; i < m * n; i++)
+            {
+                C[i] = 0.0;
+            }
+        }
+        for (int l = 0; l < k; l++)
+        {
+            const double* B_row = B + l * n;
+            for (int i = 0; i < m; i++)
+            {
+                double a = A[l * m + i];
+                double* C_row = C + i * n;
+                for (int j = 0; j < n; j++)
+                {
+                    C_row[j] += a * B_row[j];
+                }
+            }
+        }
+    }
+
+    void MatMul(const double* A, const double* B, double* C, int m, int k, int n, bool accumulate)
+    {
+        MatMulFixed<-1, -1>(A, B, C, m, k, n, accumulate);
+    }
+
+    void MatTransMul(const double* A, const double* B, double* C, int m, int k, int n, bool accumulate)
+    {
+        MatTransMulFixed<-1>(A, B, C, m, k, n, accumulate);
+    }
+
+    Scratch& GetThreadScratch()
+    {
+        static thread_local Scratch scratch;
+        return scratch;
+    }
+
+    template <int P, int Q>
+    void CalcVolumeResidualT(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                             bool curved, double gamma, ublas::vector<double>& Residual)
+    {
+        const int NP = P >= 0 ? (P + 1) * (P + 2) / 2 : -1;
+        const int num_states = 4;
+        const int Np = NumNodes<P>(resdata.Np);
+        const int Nq = Q >= 1 ? NumNodes<Q>(0) : resdata.Nq;   // geometry nodes of a curved element
+        const QuadRule2D& rule = curved ? resdata.quad_curved : resdata.quad_linear;
+        const double* GPhi_Curved = rule.GPhi_Curved.data(); // (n_quad_2d x Nq x 2)
+        int n_quad_2d = rule.n_quad;
+        const double* Phi = rule.Phi.data();         // (n_quad_2d x Np)
+        const double* GPhi_T = rule.GPhi_T.data();   // (Np x 2 n_quad_2d)
+        int n_col_max = n_batch_element * num_states;
+        int num_element = element_index.size();
+        int num_batch = (num_element + n_batch_element - 1) / n_batch_element;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int ibatch_index = 0; ibatch_index < num_batch; ibatch_index++)
+        {
+            // Scratch for one batch, the column index of every matrix is state * nb + (element in batch)
+            Scratch& scratch = GetThreadScratch();
+            scratch.UL.resize(Np * n_col_max);
+            scratch.UL_quad.resize(n_quad_2d * n_col_max);
+            scratch.F_quad.resize(2 * n_quad_2d * n_col_max);
+            scratch.RL.resize(Np * n_col_max);
+            scratch.F_point.resize(8 * n_batch_element);
+            double* U = scratch.UL.data();
+            double* U_quad = scratch.UL_quad.data();
+            double* F_ref = scratch.F_quad.data();    // weighted flux in reference space
+            double* R = scratch.RL.data();
+            double* F = scratch.F_point.data();     // (8 x nb), component (state * 2 + dim)
+
+            int ibatch = ibatch_index * n_batch_element;
+            int nb = std::min(n_batch_element, num_element - ibatch);
+            int n_col = nb * num_states;
+            // Gather the element states as the columns of U
+            for (int ie = 0; ie < nb; ie++)
+            {
+                int ielem = element_index[ibatch + ie];
+                for (int ip = 0; ip < Np; ip++)
+                {
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        U[ip * n_col + istate * nb + ie] = States(ielem * Np * num_states + ip * num_states + istate);
+                    }
+                }
+            }
+            // Interpolate all elements of the batch to all quadrature points at once
+            MatMulFixed<-1, NP>(Phi, U, U_quad, n_quad_2d, Np, n_col, false);
+            // Evaluate the flux for the whole batch on each quadrature point and pull it back to the reference element
+            for (int ig = 0; ig < n_quad_2d; ig++)
+            {
+                euler::CalcAnalyticalFluxBatch(nb, U_quad + ig * n_col, nb, gamma, F, nb);
+                for (int ie = 0; ie < nb; ie++)
+                {
+                    int ielem = element_index[ibatch + ie];
+                    // metric terms adj(J) w of this point, from the cache or recomputed from the geometry nodes
+                    const double* M;
+                    double M_point[4];
+                    if (!resdata.metric_compact)
+                    {
+                        M = curved ? &resdata.metric_curved[4 * (resdata.curved_element_ordinal[ielem] * n_quad_2d + ig)]
+                                   : &resdata.metric[4 * (ielem * n_quad_2d + ig)];
+                    }
+                    else
+                    {
+                        double w = rule.w_quad(ig);
+                        if (!curved)
+                        {
+                            const double* M_element = &resdata.metric[4 * ielem];
+                            for (int i = 0; i < 4; i++)
+                            {
+                                M_point[i] = M_element[i] * w;
+                            }
+                        }
+                        else
+                        {
+                            const double* X = &resdata.curved_element_nodes[2 * Nq * resdata.curved_element_ordinal[ielem]];
+                            const double* G = GPhi_Curved + ig * Nq * 2;
+                            double J[4] = {0.0, 0.0, 0.0, 0.0};
+                            for (int iq = 0; iq < Nq; iq++)
+                            {
+                                J[0] += X[2 * iq] * G[2 * iq];     J[1] += X[2 * iq] * G[2 * iq + 1];
+                                J[2] += X[2 * iq + 1] * G[2 * iq]; J[3] += X[2 * iq + 1] * G[2 * iq + 1];
+                            }
+                            M_point[0] = J[3] * w;  M_point[1] = -J[1] * w;
+                            M_point[2] = -J[2] * w; M_point[3] = J[0] * w;
+                        }
+                        M = M_point;
+                    }
+                    for (int d = 0; d < 2; d++)
+                    {
+                        double* F_row = &F_ref[(ig * 2 + d) * n_col + ie];
+                        for (int istate = 0; istate < num_states; istate++)
+                        {
+                            F_row[istate * nb] = M[2 * d] * F[(istate * 2) * nb + ie] + M[2 * d + 1] * F[(istate * 2 + 1) * nb + ie];
+                        }
+                    }
+                }
+            }
+            // Project onto the gradients of the test functions
+            MatMulFixed<NP, -1>(GPhi_T, F_ref, R, Np, 2 * n_quad_2d, n_col, false);
+            for (int ie = 0; ie < nb; ie++)
+            {
+                int ielem = element_index[ibatch + ie];
+                for (int ip = 0; ip < Np; ip++)
+                {
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        // the contribution from interior, !!! substracted !!!
+                        Residual(ielem * Np * num_states + ip * num_states + istate) -= R[ip * n_col + istate * nb + ie];
+                    }
+                }
+            }
+        }
+    }
+
+    template <int P>
+    void CalcVolumeResidualNodalT(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                                  double gamma, ublas::vector<double>& Residual)
+    {
+        const int NP = P >= 0 ? (P + 1) * (P + 2) / 2 : -1;
+        const int num_states = 4;
+        const int Np = NumNodes<P>(resdata.Np);
+        const double* Stiff_T = resdata.Stiff_T.data();   // (Np x 2 Np)
+        int n_col_max = n_batch_element * num_states;
+        int num_element = element_index.size();
+        int num_batch = (num_element + n_batch_element - 1) / n_batch_element;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int ibatch_index = 0; ibatch_index < num_batch; ibatch_index++)
+        {
+            // Scratch for one batch, the column index of every matrix is state * nb + (element in batch)
+            Scratch& scratch = GetThreadScratch();
+            scratch.UL.resize(Np * n_col_max);
+            scratch.F_quad.resize(2 * Np * n_col_max);
+            scratch.RL.resize(Np * n_col_max);
+            scratch.F_point.resize(8 * n_batch_element);
+            double* U = scratch.UL.data();
+            double* F_ref = scratch.F_quad.data();    // nodal flux in reference space
+            double* R = scratch.RL.data();
+            double* F = scratch.F_point.data();     // (8 x nb), component (state * 2 + dim)
+
+            int ibatch = ibatch_index * n_batch_element;
+            int nb = std::min(n_batch_element, num_element - ibatch);
+            int n_col = nb * num_states;
+            for (int ie = 0; ie < nb; ie++)
+            {
+                int ielem = element_index[ibatch + ie];
+                for (int ip = 0; ip < Np; ip++)
+                {
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        U[ip * n_col + istate * nb + ie] = States(ielem * Np * num_states + ip * num_states + istate);
+                    }
+                }
+            }
+            // Flux on the lagrange nodes, pulled back with the constant adj(J) of each element
+            for (int ip = 0; ip < Np; ip++)
+            {
+                euler::CalcAnalyticalFluxBatch(nb, U + ip * n_col, nb, gamma, F, nb);
+                for (int ie = 0; ie < nb; ie++)
+                {
+                    const double* J = &resdata.jacobian_linear[4 * element_index[ibatch + ie]];
+                    const double M[4] = {J[3], -J[1], -J[2], J[0]};
+                    for (int d = 0; d < 2; d++)
+                    {
+                        double* F_row = &F_ref[(ip * 2 + d) * n_col + ie];
+                        for (int istate = 0; istate < num_states; istate++)
+                        {
+                            F_row[istate * nb] = M[2 * d] * F[(istate * 2) * nb + ie] + M[2 * d + 1] * F[(istate * 2 + 1) * nb + ie];
+                        }
+                    }
+                }
+            }
+            // Apply the reference stiffness matrices
+            MatMulFixed<NP, (NP > 0 ? 2 * NP : -1)>(Stiff_T, F_ref, R, Np, 2 * Np, n_col, false);
+            for (int ie = 0; ie < nb; ie++)
+            {
+                int ielem = element_index[ibatch + ie];
+                for (int ip = 0; ip < Np; ip++)
+                {
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        // the contribution from interior, !!! substracted !!!
+                        Residual(ielem * Np * num_states + ip * num_states + istate) -= R[ip * n_col + istate * nb + ie];
+                    }
+                }
+            }
+        }
+    }
+
+    // Stage combination of one element whose residual block R is complete. For a linear element invM R is
+    // formed node by node in registers with the reference inverse, a curved element is solved with its Cholesky factor.
+    template <int P>
+    inline void UpdateElementT(const ResData& resdata, const StageUpdate& stage, const double* R, int ielem)
+    {
+        const int Np = NumNodes<P>(resdata.Np);
+        const int num_states = 4;
+        const mass::InvMass& inv_mass = *stage.inv_mass;
+        int offset = ielem * Np * num_states;
+        const double* R_elem = R + offset;
+        const double* U_0 = &(*stage.States_0)(offset);
+        double* U = &(*stage.States)(offset);
+        int icurved = resdata.curved_element_ordinal[ielem];
+        if (icurved < 0)
+        {
+            const double* invM_ref = inv_mass.inv_mass_ref.data();   // (Np x Np), row-major
+            double c_dt = stage.c * (*stage.dt)(ielem) * inv_mass.inv_det_jacobian[ielem];
+            for (int ip = 0; ip < Np; ip++)
+            {
+                double invM_mul_R[4] = {0.0, 0.0, 0.0, 0.0};
+                for (int jp = 0; jp < Np; jp++)
+                {
+                    double m = invM_ref[ip * Np + jp];
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        invM_mul_R[istate] += m * R_elem[jp * num_states + istate];
+                    }
+                }
+                for (int istate = 0; istate < num_states; istate++)
+                {
+                    int k = ip * num_states + istate;
+                    U[k] = stage.a * U_0[k] + stage.b * U[k] - c_dt * invM_mul_R[istate];
+                }
+            }
+        }
+        else
+        {
+            Scratch& scratch = GetThreadScratch();
+            scratch.update.resize(Np * num_states);
+            double* invM_mul_R = scratch.update.data();
+            mass::SolveCurved(inv_mass, icurved, R_elem, invM_mul_R);
+            double c_dt = stage.c * (*stage.dt)(ielem);
+            for (int k = 0; k < Np * num_states; k++)
+            {
+                U[k] = stage.a * U_0[k] + stage.b * U[k] - c_dt * invM_mul_R[k];
+            }
+        }
+    }
+
+    // Counts down the faces of ielem after a face contribution, and finishes the element with its last one,
+    // see ElementFinish
+    template <int P>
+    inline void CountFaceT(const TriMesh& mesh, const ResData& resdata, const ElementFinish& finish,
+                           const ublas::vector<double>& Residual, const ublas::vector<double>& mws_tally, int ielem)
+    {
+        if (--(*finish.faces_left)[ielem] > 0)
+            return;
+        (*finish.dt)(ielem) = 2.0 * mesh.Area[ielem] * finish.cfl / mws_tally(ielem);
+        if (finish.stage)
+        {
+            UpdateElementT<P>(resdata, *finish.stage, &Residual(0), ielem);
+        }
+    }
+
+    // One batch of nb interior edges that all belong to orientation class iclass
+    template <int P>
+    void CalcInteriorEdgeBatchT(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States, double gamma,
+                                const int* edges, int nb, int iclass, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                const ElementFinish& finish)
+    {
+        const int NP = P >= 0 ? (P + 1) * (P + 2) / 2 : -1;
+        const int num_states = 4;
+        const int Np = NumNodes<P>(resdata.Np);
+        int n_quad_1d = resdata.n_quad_1d;
+        int n_col_max = n_batch_face * num_states;
+        int n_col = nb * num_states;
+        Scratch& scratch = GetThreadScratch();
+        scratch.UL.resize(Np * n_col_max); scratch.UR.resize(Np * n_col_max);
+        scratch.UL_quad.resize(n_quad_1d * n_col_max); scratch.UR_quad.resize(n_quad_1d * n_col_max);
+        scratch.F_quad.resize(n_quad_1d * n_col_max);
+        scratch.RL.resize(Np * n_col_max); scratch.RR.resize(Np * n_col_max);
+        scratch.mws.resize(n_batch_face); scratch.mws_point.resize(n_batch_face);
+        scratch.norm.resize(2 * n_batch_face);
+        double* UL = scratch.UL.data(); double* UR = scratch.UR.data();
+        double* UL_trace = scratch.UL_quad.data(); double* UR_trace = scratch.UR_quad.data(); // trace buffer
+        double* F_trace = scratch.F_quad.data();    // weighted numerical flux
+        double* RL = scratch.RL.data(); double* RR = scratch.RR.data();
+        double* mws_face = scratch.mws.data();
+        double* mws_point = scratch.mws_point.data();
+        double* nx = scratch.norm.data(); double* ny = nx + nb;
+
+        int ilocL = iclass / 3, ilocR = iclass % 3;
+        // The trace tables are uniform within the class
+        const double* PhiL = resdata.Phi_1D.data() + ilocL * n_quad_1d * Np;
+        const double* PhiR = resdata.Phi_1D_Reversed.data() + ilocR * n_quad_1d * Np;
+        // Gather the left and right element states as the columns of UL and UR, and the edge normals
+        for (int ie = 0; ie < nb; ie++)
+        {
+            int iedge = edges[ie];
+            int ielemL = mesh.I2E.elemL[iedge]; int ielemR = mesh.I2E.elemR[iedge];
+            for (int ip = 0; ip < Np; ip++)
+            {
+                for (int istate = 0; istate < num_states; istate++)
+                {
+                    UL[ip * n_col + istate * nb + ie] = States(ielemL * Np * num_states + ip * num_states + istate);
+                    UR[ip * n_col + istate * nb + ie] = States(ielemR * Np * num_states + ip * num_states + istate);
+                }
+            }
+            nx[ie] = mesh.In.nx[iedge];
+            ny[ie] = mesh.In.ny[iedge];
+            mws_face[ie] = 0.0;
+        }
+        // Trace stage: interpolate onto the edge quadrature points once per edge
+        MatMulFixed<-1, NP>(PhiL, UL, UL_trace, n_quad_1d, Np, n_col, false);
+        MatMulFixed<-1, NP>(PhiR, UR, UR_trace, n_quad_1d, Np, n_col, false);
+        // Evaluate the numerical flux for the whole batch on each quadrature point
+        for (int ig = 0; ig < n_quad_1d; ig++)
+        {
+            double* F_row = F_trace + ig * n_col;
+            euler::CalcRoeFluxBatch(nb, UL_trace + ig * n_col, UR_trace + ig * n_col, nb, nx, ny, gamma, F_row, nb, mws_point);
+            for (int ie = 0; ie < nb; ie++)
+            {
+                double jacobian_edge = mesh.In.len[edges[ie]];
+                for (int istate = 0; istate < num_states; istate++)
+                {
+                    F_row[istate * nb + ie] = F_row[istate * nb + ie] * jacobian_edge * resdata.w_quad_1d(ig);
+                }
+                if (mws_face[ie] < mws_point[ie])
+                    mws_face[ie] = mws_point[ie];
+            }
+        }
+        // Lift the weighted flux back to the left and right test functions
+        MatTransMulFixed<NP>(PhiL, F_trace, RL, Np, n_quad_1d, n_col, false);
+        MatTransMulFixed<NP>(PhiR, F_trace, RR, Np, n_quad_1d, n_col, false);
+        for (int ie = 0; ie < nb; ie++)
+        {
+            int iedge = edges[ie];
+            int ielemL = mesh.I2E.elemL[iedge]; int ielemR = mesh.I2E.elemR[iedge];
+            for (int ip = 0; ip < Np; ip++)
+            {
+                for (int istate = 0; istate < num_states; istate++)
+                {
+                    // the contribution from edge, !!! ADD !!! to the left and !!! SUBSTRACT !!! from the right
+                    Residual(ielemL * Np * num_states + ip * num_states + istate) += RL[ip * n_col + istate * nb + ie];
+                    Residual(ielemR * Np * num_states + ip * num_states + istate) -= RR[ip * n_col + istate * nb + ie];
+                }
+            }
+            mws_tally(ielemL) += mws_face[ie] * mesh.In.len[iedge];
+            mws_tally(ielemR) += mws_face[ie] * mesh.In.len[iedge];
+            CountFaceT<P>(mesh, resdata, finish, Residual, mws_tally, ielemL);
+            CountFaceT<P>(mesh, resdata, finish, Residual, mws_tally, ielemR);
+        }
+    }
+
+    template <int P>
+    void CalcInteriorFaceResidualT(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                   double gamma, bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                   const ElementFinish& finish)
+    {
+        if (!colored)
+        {
+            for (int iclass = 0; iclass < 9; iclass++)
+            {
+                const std::vector<int>& edges = mesh.I2EClass[iclass];
+                for (int ibatch = 0; ibatch < edges.size(); ibatch += n_batch_face)
+                {
+                    int nb = std::min(n_batch_face, int(edges.size()) - ibatch);
+                    CalcInteriorEdgeBatchT<P>(mesh, resdata, States, gamma, &edges[ibatch], nb, iclass, Residual, mws_tally, finish);
+                }
+            }
+            return;
+        }
+        int num_color = mesh.I2EColor.size() / 9;
+        for (int icolor = 0; icolor < num_color; icolor++)
+        {
+            // Count the batches of every class in this color
+            int batch_offset[10];
+            batch_offset[0] = 0;
+            for (int iclass = 0; iclass < 9; iclass++)
+            {
+                int num_edge = mesh.I2EColor[icolor * 9 + iclass].size();
+                batch_offset[iclass + 1] = batch_offset[iclass] + (num_edge + n_batch_face - 1) / n_batch_face;
+            }
+            // no two edges of a color share an element, so the batches can scatter concurrently
+            #pragma omp parallel for schedule(dynamic)
+            for (int ibatch_index = 0; ibatch_index < batch_offset[9]; ibatch_index++)
+            {
+                int iclass = 0;
+                while (ibatch_index >= batch_offset[iclass + 1])
+                    iclass++;
+                const std::vector<int>& edges = mesh.I2EColor[icolor * 9 + iclass];
+                int ibatch = (ibatch_index - batch_offset[iclass]) * n_batch_face;
+                int nb = std::min(n_batch_face, int(edges.size()) - ibatch);
+                CalcInteriorEdgeBatchT<P>(mesh, resdata, States, gamma, &edges[ibatch], nb, iclass, Residual, mws_tally, finish);
+            }
+        }
+    }
+
+    // One batch of nb boundary edges of the same boundary group, curved or linear.
+    // The states, normals and edge jacobians on all quadrature points of the batch are gathered as
+    // structure of arrays (point index ie * n_quad_1d + ig), and the boundary kernel of the group
+    // evaluates them in one call.
+    template <int P>
+    void CalcBoundaryEdgeBatchT(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                const int* edges, int nb, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                const ElementFinish& finish)
+    {
+        const int num_states = 4;
+        const int Np = NumNodes<P>(resdata.Np);
+        int n_quad_1d = resdata.n_quad_1d;
+        const ublas::vector<double>& w_quad_1d = resdata.w_quad_1d;
+        const euler::BoundaryCondition& bc = resdata.boundary_conditions[mesh.B2E.group[edges[0]]];
+        int n_point = nb * n_quad_1d;
+        Scratch& scratch = GetThreadScratch();
+        scratch.UL_quad.resize(num_states * n_point);
+        scratch.F_quad.resize(num_states * n_point);
+        scratch.norm.resize(3 * n_point);
+        scratch.mws_point.resize(n_point);
+        scratch.RL.resize(Np * num_states);
+        double* U = scratch.UL_quad.data();
+        double* F = scratch.F_quad.data();
+        double* nx = scratch.norm.data(); double* ny = nx + n_point; double* jac = ny + n_point;
+        double* mws = scratch.mws_point.data();
+        double* R = scratch.RL.data();
+        // Gather the states, normals and edge jacobians on the quadrature points
+        for (int ie = 0; ie < nb; ie++)
+        {
+            int iedge = edges[ie];
+            int ielemL = mesh.B2E.elemL[iedge];
+            int ilocL = mesh.B2E.locL[iedge];
+            const double* PhiL = resdata.Phi_1D.data() + ilocL * n_quad_1d * Np;
+            // The normal on a curved edge varies along the edge, and is cached in resdata
+            int iedge_curved = resdata.curved_edge_ordinal[iedge];
+            for (int ig = 0; ig < n_quad_1d; ig++)
+            {
+                int k = ie * n_quad_1d + ig;
+                if (iedge_curved >= 0)
+                {
+                    int k_curved = iedge_curved * n_quad_1d + ig;
+                    nx[k] = resdata.curved_edge_normal[2 * k_curved];
+                    ny[k] = resdata.curved_edge_normal[2 * k_curved + 1];
+                    jac[k] = resdata.curved_edge_jacobian[k_curved];
+                }
+                else
+                {
+                    nx[k] = mesh.Bn.nx[iedge];
+                    ny[k] = mesh.Bn.ny[iedge];
+                    jac[k] = mesh.Bn.len[iedge];
+                }
+                // interpolate the LEFT state to the quadrature point
+                State u;
+                u.fill(0.0);
+                for (int ipi = 0; ipi < Np; ipi++)
+                {
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        u[istate] += PhiL[ig * Np + ipi] * States(ielemL * Np * num_states + ipi * num_states + istate);
+                    }
+                }
+                for (int istate = 0; istate < num_states; istate++)
+                {
+                    U[istate * n_point + k] = u[istate];
+                }
+            }
+        }
+        // Apply the boudary condition on all points of the batch at once
+        euler::ApplyBoundaryConditionBatch(bc, n_point, U, n_point, nx, ny, F, n_point, mws);
+        for (int ie = 0; ie < nb; ie++)
+        {
+            int iedge = edges[ie];
+            int ielemL = mesh.B2E.elemL[iedge];
+            int ilocL = mesh.B2E.locL[iedge];
+            const double* PhiL = resdata.Phi_1D.data() + ilocL * n_quad_1d * Np;
+            double mws_recorded = 0.0, jacobian_edge_recorded = 0.0;
+            for (int i = 0; i < Np * num_states; i++)
+            {
+                R[i] = 0.0;
+            }
+            for (int ig = 0; ig < n_quad_1d; ig++)
+            {
+                int k = ie * n_quad_1d + ig;
+                if (mws_recorded < mws[k])
+                    mws_recorded = mws[k];
+                if (jacobian_edge_recorded < jac[k])
+                    jacobian_edge_recorded = jac[k];
+                for (int ip = 0; ip < Np; ip++)
+                {
+                    for (int istate = 0; istate < num_states; istate++)
+                    {
+                        R[ip * num_states + istate] += PhiL[ig * Np + ip] * F[istate * n_point + k] * jac[k] * w_quad_1d(ig);
+                    }
+                }
+            }
+            for (int ip = 0; ip < Np; ip++)
+            {
+                for (int istate = 0; istate < num_states; istate++)
+                {
+                    // the contribution from edge, !!! ADD !!!
+                    Residual(ielemL * Np * num_states + ip * num_states + istate) += R[ip * num_states + istate];
+                }
+            }
+            mws_tally(ielemL) += mws_recorded * jacobian_edge_recorded;
+            CountFaceT<P>(mesh, resdata, finish, Residual, mws_tally, ielemL);
+        }
+    }
+
+    template <int P>
+    void CalcBoundaryFaceResidualT(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                   bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                   const ElementFinish& finish)
+    {
+        if (!colored)
+        {
+            for (int igroup = 0; igroup < mesh.B2EGroup.size(); igroup++)
+            {
+                const std::vector<int>& edges = mesh.B2EGroup[igroup];
+                for (int ibatch = 0; ibatch < edges.size(); ibatch += n_batch_face)
+                {
+                    int nb = std::min(n_batch_face, int(edges.size()) - ibatch);
+                    CalcBoundaryEdgeBatchT<P>(mesh, resdata, States, &edges[ibatch], nb, Residual, mws_tally, finish);
+                }
+            }
+            return;
+        }
+        for (int icolor = 0; icolor < mesh.B2EColor.size(); icolor++)
+        {
+            // The edges of a color are in group order, split them into batches of a single group
+            const std::vector<int>& edges = mesh.B2EColor[icolor];
+            std::vector<int> batch_start;
+            for (int i = 0; i < edges.size(); i++)
+            {
+                if (batch_start.empty() || i - batch_start.back() == n_batch_face
+                    || mesh.B2E.group[edges[i]] != mesh.B2E.group[edges[batch_start.back()]])
+                {
+                    batch_start.push_back(i);
+                }
+            }
+            batch_start.push_back(edges.size());
+            // no two edges of a color share an element
+            #pragma omp parallel for schedule(dynamic)
+            for (int ibatch = 0; ibatch < int(batch_start.size()) - 1; ibatch++)
+            {
+                int nb = batch_start[ibatch + 1] - batch_start[ibatch];
+                CalcBoundaryEdgeBatchT<P>(mesh, resdata, States, &edges[batch_start[ibatch]], nb, Residual, mws_tally, finish);
+            }
+        }
+    }
+
+    template <int P>
+    void ApplyStageUpdateT(const ResData& resdata, const StageUpdate& stage, const ublas::vector<double>& Residual)
+    {
+        int num_element = stage.inv_mass->inv_det_jacobian.size();
+        const double* R = &Residual(0);
+        #pragma omp parallel for
+        for (int ielem = 0; ielem < num_element; ielem++)
+        {
+            UpdateElementT<P>(resdata, stage, R, ielem);
+        }
+    }
+
+    template <int P, int Q>
+    KernelSet MakeKernelSet()
+    {
+        KernelSet kernel_set = {P, Q, P >= 0 && Q >= 1,
+                                &CalcVolumeResidualT<P, Q>, &CalcVolumeResidualNodalT<P>,
+                                &CalcInteriorFaceResidualT<P>, &CalcBoundaryFaceResidualT<P>,
+                                &ApplyStageUpdateT<P>};
+        return kernel_set;
+    }
+
+    const KernelSet* SelectKernelSet(int p, int q)
+    {
+        static const KernelSet specialized[max_order_specialized + 1][max_order_geo_specialized] = {
+            {MakeKernelSet<0, 1>(), MakeKernelSet<0, 2>(), MakeKernelSet<0, 3>(), MakeKernelSet<0, 4>()},
+            {MakeKernelSet<1, 1>(), MakeKernelSet<1, 2>(), MakeKernelSet<1, 3>(), MakeKernelSet<1, 4>()},
+            {MakeKernelSet<2, 1>(), MakeKernelSet<2, 2>(), MakeKernelSet<2, 3>(), MakeKernelSet<2, 4>()},
+            {MakeKernelSet<3, 1>(), MakeKernelSet<3, 2>(), MakeKernelSet<3, 3>(), MakeKernelSet<3, 4>()},
+            {MakeKernelSet<4, 1>(), MakeKernelSet<4, 2>(), MakeKernelSet<4, 3>(), MakeKernelSet<4, 4>()}};
+        static const KernelSet generic = MakeKernelSet<-1, -1>();
+        if (p >= 0 && p <= max_order_specialized && q >= 1 && q <= max_order_geo_specialized)
+        {
+            return &specialized[p][q - 1];
+        }
+        return &generic;
+    }
+
+    void CalcVolumeResidual(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                            bool curved, double gamma, ublas::vector<double>& Residual)
+    {
+        resdata.kernel_set->volume(resdata, States, element_index, curved, gamma, Residual);
+    }
+
+    void CalcVolumeResidualNodal(const ResData& resdata, const ublas::vector<double>& States, const std::vector<int>& element_index,
+                                 double gamma, ublas::vector<double>& Residual)
+    {
+        resdata.kernel_set->volume_nodal(resdata, States, element_index, gamma, Residual);
+    }
+
+    void CalcInteriorFaceResidual(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                  double gamma, bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                  const ElementFinish& finish)
+    {
+        resdata.kernel_set->interior_face(mesh, resdata, States, gamma, colored, Residual, mws_tally, finish);
+    }
+
+    void CalcBoundaryFaceResidual(const TriMesh& mesh, const ResData& resdata, const ublas::vector<double>& States,
+                                  bool colored, ublas::vector<double>& Residual, ublas::vector<double>& mws_tally,
+                                  const ElementFinish& finish)
+    {
+        resdata.kernel_set->boundary_face(mesh, resdata, States, colored, Residual, mws_tally, finish);
+    }
+
+    void ApplyStageUpdate(const ResData& resdata, const StageUpdate& stage, const ublas::vector<double>& Residual)
+    {
+        resdata.kernel_set->stage_update(resdata, stage, Residual);
+    }
+
+} // namespace kernels
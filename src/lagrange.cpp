@@ -80,33 +80,42 @@ namespace lagrange
         return node_physical;
     }
 
-        ublas::vector<ublas::vector<double> > MapReferenceToPhysical(TriMesh mesh,  int ielem, int p, double (*pBumpFunction)(double))
+        ublas::vector<ublas::vector<double> > MapReferenceToPhysical(const TriMesh& mesh,  int ielem, int p, double (*pBumpFunction)(double))
+    {
+        // Now loop through B2E, find out what is the local index of the curved edge
+        int iloc_curved = -1;
+        if (p > 1)
+        {
+            for (int iedge = 0; iedge < mesh.B2E.size(); iedge++)
+            {
+                if ((mesh.B2E[iedge][0] == ielem + 1) && (mesh.B2E[iedge][2] == mesh.curved_group)) // this element is on the curved boudary and the local index is got
+                {
+                    iloc_curved = mesh.B2E[iedge][1] - 1;
+                }
+            }
+        }
+        return MapReferenceToPhysical(mesh, ielem, p, pBumpFunction, iloc_curved);
+    }
+
+    ublas::vector<ublas::vector<double> > MapReferenceToPhysical(const TriMesh& mesh,  int ielem, int p, double (*pBumpFunction)(double), int iloc_curved)
     {
         int Np = int((p + 1) * (p + 2) / 2); // number of basis functions
         ublas::vector<ublas::vector<double> > node_physical(Np, ublas::vector<double> (2, 1));
         ublas::vector<ublas::vector<double> > vertex(3, ublas::vector<double> (2, 0.0));
-        std::vector<int> ind_vertex = utils::GetVertexIndex(mesh.E[ielem]);
+        std::vector<int> ind_vertex = utils::GetVertexIndex(mesh.E[ielem].size());
         for (int i = 0; i < 3; i++)
         {
             vertex[i][0] = mesh.V[mesh.E[ielem][ind_vertex[i]] - 1][0];
             vertex[i][1] = mesh.V[mesh.E[ielem][ind_vertex[i]] - 1][1];
         }
         node_physical = MapReferenceToPhysicalLinear(vertex, p); // First get the cordinates as the linear element
-        // Now loop through B2E, find out what is the local index of the curved edge
-        if (p > 1)
+        if (p > 1 && iloc_curved >= 0)
         {
-            for (int iedge = 0; iedge < mesh.B2E.size(); iedge++)
+            ublas::vector<int> selected_lagrange_index = geometry::GetEdgeLagrangeNodeIndex(p, iloc_curved);
+            for (int iedge_node = 0; iedge_node < selected_lagrange_index.size(); iedge_node++)
             {
-                if ((mesh.B2E[iedge][0] == ielem + 1) && (mesh.B2E[iedge][2] == mesh.curved_group)) // this element is on the curved boudary and the local index is got
-                {
-                    int iloc = mesh.B2E[iedge][1] - 1;
-                    ublas::vector<int> selected_lagrange_index = geometry::GetEdgeLagrangeNodeIndex(p, iloc);
-                    for (int iedge_node = 0; iedge_node < selected_lagrange_index.size(); iedge_node++)
-                    {
-                        int inode = selected_lagrange_index[iedge_node];
-                        node_physical[inode][1] = pBumpFunction(node_physical[inode][0]);
-                    }
-                }
+                int inode = selected_lagrange_index[iedge_node];
+                node_physical[inode][1] = pBumpFunction(node_physical[inode][0]);
             }
         }
         return node_physical;
@@ -138,103 +147,7 @@ namespace lagrange
         return node_reference;
     }
 
-    ublas::vector<ublas::matrix<double> > ConstructMassMatrix(int p, TriMesh mesh, ResData resdata)
-    {
-        int Np = int((p + 1) * (p + 2) / 2);
-        int num_element = mesh.E.size();
-        ublas::vector<ublas::matrix<double> > mat_mass (num_element, ublas::matrix<double> (Np, Np, 0.0));
-        ublas::matrix<double> unit_mat_mass (Np, Np, 0.0);
-        std::vector<double> xq_std;
-        std::vector<double> wq_std;
-        int n_quad_2d;
-        GetQuadraturePointsWeight2D(9, n_quad_2d, xq_std, wq_std);
-        // transfer the std vectors to ublas vectors
-        ublas::vector<double> xq = utils::StdToBoostVector(xq_std);
-        ublas::vector<double> wq = utils::StdToBoostVector(wq_std);
-        ublas::matrix<double> TriLagrangeCoeff = TriangleLagrange2D(p);
-        // Compute the base functions on all quadrature points
-        ublas::matrix<double> Phi(n_quad_2d, Np); // Basis function value on qudatrue points
-        for (int ig = 0; ig < n_quad_2d; ig++)
-        {
-            double xi = xq(2 * ig);
-            double eta = xq(2 * ig + 1);
-            ublas::vector<double> phi = CalcBaseFunction(TriLagrangeCoeff, xi, eta);
-            for (int ip = 0; ip < Np; ip++)
-            {
-                Phi(ig, ip) = phi(ip);
-            }
-        }
-        // Do the Gussian quadrature integration for linear element
-        unit_mat_mass.clear();
-        for (int i = 0; i < Np; i++)
-        {
-            for (int j = 0; j < Np; j++)
-            {
-                for (int ig = 0; ig < n_quad_2d; ig++)
-                {
-                    // unit mass matrix is the same in reference space is the same for linear elements
-                    unit_mat_mass(i, j) += Phi(ig, i) * Phi(ig, j) * wq(ig);
-                }
-            }
-        }
-        // Fill the term of block-diagonal parts for linear elements
-        for (int i_elem = 0; i_elem < num_element; i_elem++)
-        {
-            ublas::matrix<double> jacobian = geometry::CalcJacobianLinear(mesh, i_elem);
-            double det_jacobian = jacobian(0, 0) * jacobian(1, 1) - jacobian(0, 1) * jacobian(1, 0);
-            if (!mesh.isCurved[i_elem])
-            {
-                for (int i = 0; i < Np; i++)
-                {
-                    for (int j = 0; j < Np; j++)
-                    {
-                        mat_mass (i_elem)(i, j) = unit_mat_mass (i, j) * det_jacobian;
-                    }
-                }
-            }
-        }
-        // Fill the term of block-diagonal parts for curved elements
-        for (int i_elem = 0; i_elem < num_element; i_elem++)
-        {
-            if (mesh.isCurved[i_elem])
-            {
-                for (int i = 0; i < Np; i++)
-                {
-                    for (int j = 0; j < Np; j++)
-                    {
-                        unit_mat_mass.clear();
-                        double det_jacobian = 0.0;
-                        for (int ig = 0; ig < n_quad_2d; ig++)
-                        {
-                            // unit mass matrix is the same in reference space is the same for linear elements
-                            ublas::matrix<double> jacobian = geometry::CalcJacobianCurved(mesh, i_elem, resdata.GPhi_Curved, n_quad_2d, ig);
-                            det_jacobian = jacobian(0, 0) * jacobian(1, 1) - jacobian(0, 1) * jacobian(1, 0);
-                            unit_mat_mass(i, j) += Phi(ig, i) * Phi(ig, j) * det_jacobian * wq(ig);
-                        }
-                        mat_mass (i_elem)(i, j) = unit_mat_mass (i, j);
-                    }
-                }
-            }
-        }
-        return mat_mass;
-    }
-
-    ublas::vector<ublas::matrix<double> > CalcInvMassMatrix(ublas::vector<ublas::matrix<double> > M)
-    {
-        int num_elem = M.size();
-        int Np = M(0).size1();
-        ublas::vector<ublas::matrix<double> > invM(num_elem, ublas::matrix<double>(Np, Np, 0.0));
-        for (int ielem = 0; ielem < num_elem; ielem++)
-        {
-            ublas::matrix<double> unit_invM (Np, Np, 0.0);
-            ublas::matrix<double> unit_M = M(ielem);
-            InvertMatrix(unit_M, unit_invM);
-            invM(ielem) = unit_invM;
-        }
-        return invM;
-    }
-
-    ublas::vector<double> CalcBaseFunction(ublas::matrix<double> TriLagrangeCoeff, double xi, double eta)
+    ublas::vector<double> CalcBaseFunction(const ublas::matrix<double>& TriLagrangeCoeff, double xi, double eta)
     {
         int num_poly = TriLagrangeCoeff.size2();
         int p = int((sqrt(1 + 8.0 * num_poly) - 3) / 2);
@@ -261,7 +174,7 @@ namespace lagrange
         return phi;
     }
 
-    ublas::matrix<double> CalcBaseFunctionGradient(ublas::matrix<double> TriLagrangeCoeff, double xi, double eta)
+    ublas::matrix<double> CalcBaseFunctionGradient(const ublas::matrix<double>& TriLagrangeCoeff, double xi, double eta)
     {
         int num_poly = TriLagrangeCoeff.size2();
         int p = int((sqrt(1 + 8.0 * num_poly) - 3) / 2);
@@ -2,6 +2,7 @@
 #include <fstream>
 #include <algorithm>
 #include <complex>
+#include <chrono>
 #include <boost/numeric/ublas/matrix_sparse.hpp>
 #include <boost/numeric/ublas/io.hpp>
 #include <boost/algorithm/minmax.hpp>
@@ -17,11 +18,20 @@
 #include "../include/Param.h"
 #include "../include/Collective.h"
 #include "../include/InvertMatrix.h"
+#include "../include/ordering.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace utils;
 using namespace lagrange;
 
+// Wall time in seconds since time_start
+static double Elapsed(chrono::steady_clock::time_point time_start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - time_start).count();
+}
 
 int main(int argc, char *argv[])
 {
@@ -30,14 +40,32 @@ int main(int argc, char *argv[])
     Param param;
     // Set up the param struct
     param = ReadParamIn(string(argv[1]));
-    TriMesh mesh(param.mesh_file);
-    // Testing Calculate Residaul
+#ifdef _OPENMP
+    omp_set_num_threads(param.num_threads);
+#endif
+    // Setup phase: curved mesh, residual data and mass matrices, each timed on its own
     int p = param.order;
     int q = param.order_geo;
     int Np = int((p + 1) * (p + 2) / 2);
-    TriMesh curved_mesh = mesh;
     string boundary_name="bottom";
-    ConstructCurveMesh(mesh, curved_mesh, geometry::BumpFunction, boundary_name, q);
+    chrono::steady_clock::time_point time_phase = chrono::steady_clock::now();
+    TriMesh curved_mesh;
+    LoadCurvedMesh(param.mesh_file, curved_mesh, geometry::BumpFunction, boundary_name, q, strcasecmp(param.mesh_cache.c_str(), "on") == 0);
+    // Optional renumbering for locality, the output below is written back in the element order of the .gri
+    chrono::steady_clock::time_point time_start = chrono::steady_clock::now();
+    if (ordering::ReorderMesh(curved_mesh, param.mesh_ordering, Np * 4 * sizeof(double)))
+    {
+        curved_mesh.SetupTime.push_back(make_pair(string("Renumber"), Elapsed(time_start)));
+    }
+    double time_mesh = Elapsed(time_phase);
+    std::cout << "Mesh setup:";
+    for (int istep = 0; istep < curved_mesh.SetupTime.size(); istep++)
+    {
+        std::cout << ' ' << curved_mesh.SetupTime[istep].first << ' ' << curved_mesh.SetupTime[istep].second << " s";
+    }
+    std::cout << std::endl;
+    std::cout << "Mesh storage: " << curved_mesh.MemoryBytes(false) / 1048576.0 << " MB (nested-row layout: "
+              << curved_mesh.MemoryBytes(true) / 1048576.0 << " MB)" << std::endl;
 
 
     ublas::vector<double> States (curved_mesh.num_element * Np * 4, 0.0);
@@ -54,43 +82,103 @@ int main(int argc, char *argv[])
         }
     }
 
-    ResData resdata, resdata_postproc;
-    solver::CalcResData(curved_mesh, p, resdata);
-    if (p == 0)
-    {
-        solver::CalcResData(curved_mesh, 1, resdata_postproc);
-    }else
+    // The element geometry is computed once here and shared by the residual, the mass matrices and the output
+    time_phase = chrono::steady_clock::now();
+    ResData resdata;
+    solver::CalcResData(curved_mesh, p, param, resdata);
+    solver::CalcBoundaryConditions(curved_mesh, param, resdata);
+    solver::CalcMetricCache(curved_mesh, param, resdata);
+    double time_resdata = Elapsed(time_phase);
+    std::cout << "Quadrature: linear elements order " << resdata.quad_linear.order << " (" << resdata.quad_linear.n_quad
+              << " points), curved elements order " << resdata.quad_curved.order << " (" << resdata.quad_curved.n_quad
+              << " points), edges order " << resdata.quad_order_1d << " (" << resdata.n_quad_1d << " points)" << std::endl;
+    if (!resdata.kernel_set->specialized)
     {
-        solver::CalcResData(curved_mesh, p, resdata_postproc);
+        std::cout << "No specialized residual kernels for p = " << p << ", q = " << q << ", using the generic kernels" << std::endl;
     }
 
     ublas::vector<double> dt(curved_mesh.E.size());
     // ublas::vector<double> Residual = solver::CalcResidual(curved_mesh, param, resdata, States, dt, p);
     // cout << setprecision(20) << ublas::norm_2(Residual) << endl;
-    ublas::vector<ublas::matrix<double> > M = lagrange::ConstructMassMatrix(p, curved_mesh, resdata);
-    ublas::vector<ublas::matrix<double> > invM = lagrange::CalcInvMassMatrix(M);
+#ifdef _OPENMP
+    if (param.num_threads > 1)
+    {
+        // Time one residual evaluation on a single thread and on all threads
+        solver::CalcResidual(curved_mesh, param, resdata, States, dt, p); // warm up the per-thread scratch
+        omp_set_num_threads(1);
+        double time_start = omp_get_wtime();
+        solver::CalcResidual(curved_mesh, param, resdata, States, dt, p);
+        double time_serial = omp_get_wtime() - time_start;
+        omp_set_num_threads(param.num_threads);
+        time_start = omp_get_wtime();
+        solver::CalcResidual(curved_mesh, param, resdata, States, dt, p);
+        double time_parallel = omp_get_wtime() - time_start;
+        std::cout << "Residual evaluation: 1 thread " << time_serial << " s, " << param.num_threads << " threads "
+                  << time_parallel << " s, speedup " << time_serial / time_parallel << std::endl;
+    }
+#endif
+    time_phase = chrono::steady_clock::now();
+    mass::InvMass inv_mass;
+    mass::ConstructInvMass(p, curved_mesh, resdata, inv_mass);
+    double time_mass = Elapsed(time_phase);
+    // The compact metric policy rebuilds the curved jacobians from the geometry nodes, the per-point ones
+    // were only needed by the mass matrices
+    if (resdata.metric_compact)
+    {
+        std::vector<double>().swap(resdata.jacobian_curved);
+    }
+    // Memory of the element geometry kept for the solve, jacobians and metric cache, against the former
+    // E x n_quad_2d matrix-of-matrices layout of J and invJ
+    double jacobian_mb = (resdata.jacobian_linear.size() + resdata.jacobian_curved.size()) * sizeof(double) / 1048576.0
+                       + resdata.curved_element_ordinal.size() * sizeof(int) / 1048576.0;
+    double metric_mb = (resdata.metric.size() + resdata.metric_curved.size() + resdata.curved_element_nodes.size())
+                     * sizeof(double) / 1048576.0;
+    double jacobian_mb_matrix = 2.0 * curved_mesh.E.size() * (resdata.quad_curved.n_quad + 1)
+                              * (sizeof(ublas::matrix<double>) + 4 * sizeof(double)) / 1048576.0;
+    std::cout << "Element geometry storage: jacobians " << jacobian_mb << " MB, metric cache (" << param.metric_storage << ") "
+              << metric_mb << " MB, total " << jacobian_mb + metric_mb << " MB (matrix-of-matrices layout: "
+              << jacobian_mb_matrix << " MB)" << std::endl;
+    std::cout << "Setup time: " << time_mesh + time_resdata + time_mass << " s (mesh " << time_mesh
+              << " s, residual data " << time_resdata << " s, mass matrices "
+              << time_mass << " s)" << std::endl;
+    // Against one full Np x Np inverse per element
+    double inv_mass_mb_full = curved_mesh.E.size() * (sizeof(ublas::matrix<double>) + Np * Np * sizeof(double)) / 1048576.0;
+    std::cout << "Inverse mass storage: " << mass::MemoryBytes(inv_mass) / 1048576.0 << " MB (per-element inverses: "
+              << inv_mass_mb_full << " MB)" << std::endl;
     int MAXITER = param.MAXITER;
     int converged = 0;
-    ublas::vector<double> States_new (curved_mesh.num_element * Np * 4, 0.0);
     ofstream file_residual;
     file_residual.open("residual.log");
+    // Registers of the integrator, the states themselves are updated in place
+    solver::RKWorkspace workspace;
+    if (strcasecmp(param.time_integrator.c_str(), "ssprk2") == 0)
+    {
+        std::cout << "Time integrator: SSPRK(" << param.rk_stages << ",2), low storage" << std::endl;
+    }else
+    {
+        std::cout << "Time integrator: TVDRK3, low storage" << std::endl;
+    }
+    bool norm_on_output = (strcasecmp(param.residual_norm.c_str(), "output") == 0);
+    time_phase = chrono::steady_clock::now();
     for (int niter = 0; niter < MAXITER; niter++)
     {
         // cout << niter << endl;
         double norm_residual = 0.0;
-        States_new = solver::TimeMarching_TVDRK3(curved_mesh, param, resdata, States, invM, p, converged, norm_residual);
+        bool check_norm = !norm_on_output || niter % param.dnOutput == 0;
+        solver::TimeMarching_SSPRK(curved_mesh, param, resdata, States, inv_mass, p, workspace, check_norm, converged, norm_residual);
 	    if (niter % param.dnOutput == 0)
 	    {
             std::cout << "NITER: " << niter << "\t" << "Residual Norm_Inf: ";
             cout.setf(ios::scientific, ios::floatfield);
             std::cout << setprecision(10) << norm_residual << std::endl;
         }
-        file_residual << niter << "\t" << setprecision(20) << norm_residual << std::endl;
-        States = States_new;
+        if (check_norm)
+            file_residual << niter << "\t" << setprecision(20) << norm_residual << std::endl;
         if (converged)
            break;
     }
     file_residual.close();
+    std::cout << "Solve time: " << Elapsed(time_phase) << " s" << std::endl;
 
     // PostProcessing the States, the output will be the global coordinate of the lagrange nodes in each element and the states on the nodes
     int Np_solution;
@@ -106,8 +194,10 @@ int main(int argc, char *argv[])
     file_nodes.open("nodes.dat");
     file_states.open("states.dat");
     file_info.open("info.dat");
-    for (int ielem = 0; ielem < curved_mesh.E.size(); ielem++)
+    vector<int> element_in_file_order = curved_mesh.ElementsInFileOrder();
+    for (int ifile = 0; ifile < curved_mesh.E.size(); ifile++)
     {
+        int ielem = element_in_file_order[ifile];
         for (int ip = 0; ip < Np_solution; ip++)
         {
             file_nodes  << Nodes(ielem)(ip, 0) << ' ' << Nodes(ielem)(ip, 1) << std::endl;
@@ -0,0 +1,137 @@
+#include "../include/mass.h"
+
+namespace ublas = boost::numeric::ublas;
+
+namespace mass
+{
+
+    void ConstructInvMass(int p, const TriMesh& mesh, const ResData& resdata, InvMass& inv_mass)
+    {
+        int Np = int((p + 1) * (p + 2) / 2);
+        int num_element = mesh.E.size();
+        int num_curved_element = mesh.CurvedElementIndex.size();
+        inv_mass.Np = Np;
+
+        // Reference mass matrix, the same for all linear elements up to detJ
+        const QuadRule2D& rule_linear = resdata.quad_linear;
+        ublas::matrix<double> mass_ref (Np, Np, 0.0);
+        for (int i = 0; i < Np; i++)
+        {
+            for (int j = 0; j < Np; j++)
+            {
+                for (int ig = 0; ig < rule_linear.n_quad; ig++)
+                {
+                    mass_ref(i, j) += rule_linear.Phi[ig][i] * rule_linear.Phi[ig][j] * rule_linear.w_quad(ig);
+                }
+            }
+        }
+        ublas::matrix<double> inv_mass_ref (Np, Np, 0.0);
+        InvertMatrix(mass_ref, inv_mass_ref);
+        inv_mass.inv_mass_ref.resize(Np * Np);
+        for (int i = 0; i < Np; i++)
+        {
+            for (int j = 0; j < Np; j++)
+            {
+                inv_mass.inv_mass_ref[i * Np + j] = inv_mass_ref(i, j);
+            }
+        }
+        inv_mass.inv_det_jacobian.assign(num_element, 0.0);
+        #pragma omp parallel for
+        for (int i_linear_elem = 0; i_linear_elem < mesh.LinearElementIndex.size(); i_linear_elem++)
+        {
+            int ielem = mesh.LinearElementIndex[i_linear_elem];
+            const double* jacobian = &resdata.jacobian_linear[4 * ielem];
+            inv_mass.inv_det_jacobian[ielem] = 1.0 / (jacobian[0] * jacobian[3] - jacobian[1] * jacobian[2]);
+        }
+
+        // Curved elements, mass matrix on the curved rule and its Cholesky factor
+        const QuadRule2D& rule_curved = resdata.quad_curved;
+        inv_mass.cholesky.assign(num_curved_element * Np * Np, 0.0);
+        bool positive_definite = true;
+        #pragma omp parallel for schedule(dynamic) reduction(&&:positive_definite)
+        for (int i_curved_elem = 0; i_curved_elem < num_curved_element; i_curved_elem++)
+        {
+            std::vector<double> mass_elem (Np * Np, 0.0);
+            for (int ig = 0; ig < rule_curved.n_quad; ig++)
+            {
+                const double* jacobian = &resdata.jacobian_curved[4 * (i_curved_elem * rule_curved.n_quad + ig)];
+                double det_jacobian = jacobian[0] * jacobian[3] - jacobian[1] * jacobian[2];
+                for (int i = 0; i < Np; i++)
+                {
+                    for (int j = 0; j < Np; j++)
+                    {
+                        mass_elem[i * Np + j] += rule_curved.Phi[ig][i] * rule_curved.Phi[ig][j] * det_jacobian * rule_curved.w_quad(ig);
+                    }
+                }
+            }
+            double* L = &inv_mass.cholesky[i_curved_elem * Np * Np];
+            for (int j = 0; j < Np; j++)
+            {
+                double diag = mass_elem[j * Np + j];
+                for (int k = 0; k < j; k++)
+                {
+                    diag -= L[j * Np + k] * L[j * Np + k];
+                }
+                if (diag <= 0.0)
+                {
+                    positive_definite = false;
+                    diag = 1.0;
+                }
+                L[j * Np + j] = 1.0 / sqrt(diag);
+                for (int i = j + 1; i < Np; i++)
+                {
+                    double sum = mass_elem[i * Np + j];
+                    for (int k = 0; k < j; k++)
+                    {
+                        sum -= L[i * Np + k] * L[j * Np + k];
+                    }
+                    L[i * Np + j] = sum * L[j * Np + j];
+                }
+            }
+        }
+        if (!positive_definite)
+        {
+            std::cout << "Mass matrix of a curved element is not positive definite, Aborting..." << std::endl;
+            abort();
+        }
+    }
+
+    void SolveCurved(const InvMass& inv_mass, int icurved, const double* X, double* Y)
+    {
+        int Np = inv_mass.Np;
+        const int num_states = 4;
+        const double* L = &inv_mass.cholesky[icurved * Np * Np];
+        // L Z = X
+        for (int i = 0; i < Np; i++)
+        {
+            for (int istate = 0; istate < num_states; istate++)
+            {
+                double sum = X[i * num_states + istate];
+                for (int k = 0; k < i; k++)
+                {
+                    sum -= L[i * Np + k] * Y[k * num_states + istate];
+                }
+                Y[i * num_states + istate] = sum * L[i * Np + i];
+            }
+        }
+        // L^T Y = Z
+        for (int i = Np - 1; i >= 0; i--)
+        {
+            for (int istate = 0; istate < num_states; istate++)
+            {
+                double sum = Y[i * num_states + istate];
+                for (int k = i + 1; k < Np; k++)
+                {
+                    sum -= L[k * Np + i] * Y[k * num_states + istate];
+                }
+                Y[i * num_states + istate] = sum * L[i * Np + i];
+            }
+        }
+    }
+
+    double MemoryBytes(const InvMass& inv_mass)
+    {
+        return (inv_mass.inv_mass_ref.size() + inv_mass.inv_det_jacobian.size() + inv_mass.cholesky.size()) * sizeof(double);
+    }
+
+} // namespace mass
@@ -0,0 +1,281 @@
+#include "../include/ordering.h"
+
+namespace ordering
+{
+
+    // Neighbours of every element across the interior faces, as offset-indexed flat arrays
+    static void ElementGraph(const TriMesh& mesh, std::vector<int>& offset, std::vector<int>& neighbour)
+    {
+        int num_element = mesh.num_element;
+        offset.assign(num_element + 1, 0);
+        for (int iedge = 0; iedge < mesh.I2E.size(); iedge++)
+        {
+            offset[mesh.I2E.elemL[iedge] + 1]++;
+            offset[mesh.I2E.elemR[iedge] + 1]++;
+        }
+        for (int ielem = 0; ielem < num_element; ielem++)
+        {
+            offset[ielem + 1] += offset[ielem];
+        }
+        neighbour.resize(offset[num_element]);
+        std::vector<int> position(offset.begin(), offset.end() - 1);
+        for (int iedge = 0; iedge < mesh.I2E.size(); iedge++)
+        {
+            neighbour[position[mesh.I2E.elemL[iedge]]++] = mesh.I2E.elemR[iedge];
+            neighbour[position[mesh.I2E.elemR[iedge]]++] = mesh.I2E.elemL[iedge];
+        }
+    }
+
+    // Breadth-first levels from start over the unvisited elements, level -1 marks unvisited.
+    // Returns the elements in the order they were reached, the neighbours of an element by increasing degree.
+    static std::vector<int> BreadthFirst(const std::vector<int>& offset, const std::vector<int>& neighbour, int start,
+                                         std::vector<int>& level)
+    {
+        std::vector<int> queue(1, start);
+        level[start] = 0;
+        std::vector<int> next;
+        for (int ihead = 0; ihead < queue.size(); ihead++)
+        {
+            int ielem = queue[ihead];
+            next.clear();
+            for (int k = offset[ielem]; k < offset[ielem + 1]; k++)
+            {
+                if (level[neighbour[k]] < 0)
+                {
+                    level[neighbour[k]] = level[ielem] + 1;
+                    next.push_back(neighbour[k]);
+                }
+            }
+            std::sort(next.begin(), next.end(), [&offset](int a, int b)
+                      { int da = offset[a + 1] - offset[a], db = offset[b + 1] - offset[b]; return da < db || (da == db && a < b); });
+            queue.insert(queue.end(), next.begin(), next.end());
+        }
+        return queue;
+    }
+
+    std::vector<int> ElementOrderRCM(const TriMesh& mesh)
+    {
+        int num_element = mesh.num_element;
+        std::vector<int> offset, neighbour;
+        ElementGraph(mesh, offset, neighbour);
+        std::vector<int> order;
+        order.reserve(num_element);
+        std::vector<int> level(num_element, -1);
+        std::vector<int> level_trial(num_element, -1);
+        for (int iseed = 0; iseed < num_element; iseed++)
+        {
+            if (level[iseed] >= 0)
+                continue;
+            // Pseudo-peripheral start: move to a least-degree element of the last level while the depth grows
+            int start = iseed;
+            int depth = -1;
+            for (int isweep = 0; isweep < 4; isweep++)
+            {
+                std::vector<int> component = BreadthFirst(offset, neighbour, start, level_trial);
+                int depth_new = level_trial[component.back()];
+                int candidate = component.back();
+                for (int i = component.size() - 1; i >= 0 && level_trial[component[i]] == depth_new; i--)
+                {
+                    int c = component[i];
+                    if (offset[c + 1] - offset[c] < offset[candidate + 1] - offset[candidate])
+                        candidate = c;
+                }
+                for (int i = 0; i < component.size(); i++)
+                    level_trial[component[i]] = -1;
+                if (depth_new <= depth)
+                    break;
+                depth = depth_new;
+                start = candidate;
+            }
+            std::vector<int> component = BreadthFirst(offset, neighbour, start, level);
+            order.insert(order.end(), component.begin(), component.end());
+        }
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+
+    // Vertex centroids of the elements quantized to [0, 2^16) on the bounding box
+    static void QuantizedCentroids(const TriMesh& mesh, std::vector<uint32_t>& ix, std::vector<uint32_t>& iy)
+    {
+        int num_element = mesh.num_element;
+        std::vector<double> cx(num_element), cy(num_element);
+        for (int ielem = 0; ielem < num_element; ielem++)
+        {
+            std::vector<int> vertex_index = utils::GetVertexIndex(mesh.E[ielem].size());
+            cx[ielem] = 0.0; cy[ielem] = 0.0;
+            for (int i = 0; i < 3; i++)
+            {
+                int inode = mesh.E[ielem][vertex_index[i]] - 1;
+                cx[ielem] += mesh.V.x[inode] / 3.0;
+                cy[ielem] += mesh.V.y[inode] / 3.0;
+            }
+        }
+        double xmin = *std::min_element(cx.begin(), cx.end()), xmax = *std::max_element(cx.begin(), cx.end());
+        double ymin = *std::min_element(cy.begin(), cy.end()), ymax = *std::max_element(cy.begin(), cy.end());
+        // One scale for both directions keeps the cells square
+        double scale = 65535.0 / std::max(std::max(xmax - xmin, ymax - ymin), 1e-300);
+        ix.resize(num_element); iy.resize(num_element);
+        for (int ielem = 0; ielem < num_element; ielem++)
+        {
+            ix[ielem] = uint32_t((cx[ielem] - xmin) * scale);
+            iy[ielem] = uint32_t((cy[ielem] - ymin) * scale);
+        }
+    }
+
+    // Elements sorted by key, ties by index
+    static std::vector<int> SortByKey(const std::vector<uint64_t>& key)
+    {
+        std::vector<int> order(key.size());
+        for (int ielem = 0; ielem < order.size(); ielem++)
+            order[ielem] = ielem;
+        std::sort(order.begin(), order.end(), [&key](int a, int b) { return key[a] < key[b] || (key[a] == key[b] && a < b); });
+        return order;
+    }
+
+    // Bits of x spread to the even bit positions
+    static uint64_t SpreadBits(uint32_t x)
+    {
+        uint64_t v = x & 0xffff;
+        v = (v | (v << 8)) & 0x00ff00ffULL;
+        v = (v | (v << 4)) & 0x0f0f0f0fULL;
+        v = (v | (v << 2)) & 0x33333333ULL;
+        v = (v | (v << 1)) & 0x55555555ULL;
+        return v;
+    }
+
+    std::vector<int> ElementOrderMorton(const TriMesh& mesh)
+    {
+        std::vector<uint32_t> ix, iy;
+        QuantizedCentroids(mesh, ix, iy);
+        std::vector<uint64_t> key(ix.size());
+        for (int ielem = 0; ielem < key.size(); ielem++)
+            key[ielem] = SpreadBits(ix[ielem]) | (SpreadBits(iy[ielem]) << 1);
+        return SortByKey(key);
+    }
+
+    std::vector<int> ElementOrderHilbert(const TriMesh& mesh)
+    {
+        std::vector<uint32_t> ix, iy;
+        QuantizedCentroids(mesh, ix, iy);
+        const uint32_t n = 1u << 16;
+        std::vector<uint64_t> key(ix.size());
+        for (int ielem = 0; ielem < key.size(); ielem++)
+        {
+            // Distance along the Hilbert curve of order 16, rotating the quadrant at every level
+            uint32_t x = ix[ielem], y = iy[ielem];
+            uint64_t d = 0;
+            for (uint32_t s = n / 2; s > 0; s /= 2)
+            {
+                uint32_t rx = (x & s) > 0;
+                uint32_t ry = (y & s) > 0;
+                d += uint64_t(s) * s * ((3 * rx) ^ ry);
+                if (ry == 0)
+                {
+                    if (rx == 1)
+                    {
+                        x = n - 1 - x;
+                        y = n - 1 - y;
+                    }
+                    std::swap(x, y);
+                }
+            }
+            key[ielem] = d;
+        }
+        return SortByKey(key);
+    }
+
+    double FaceBandwidth(const TriMesh& mesh)
+    {
+        double sum = 0.0;
+        for (int iedge = 0; iedge < mesh.I2E.size(); iedge++)
+            sum += std::abs(mesh.I2E.elemR[iedge] - mesh.I2E.elemL[iedge]);
+        return mesh.I2E.size() > 0 ? sum / mesh.I2E.size() : 0.0;
+    }
+
+    long long FaceSweepMisses(const TriMesh& mesh, int block_bytes, int line_bytes, int num_lines)
+    {
+        // An access hits an LRU cache of num_lines lines iff fewer than num_lines other lines were used
+        // since the last access to the same line. The last access times are marked in a Fenwick tree
+        // over the access sequence, so the distinct lines in between are one prefix sum.
+        std::vector<int> access;
+        access.reserve(2 * mesh.I2E.size() * (block_bytes / line_bytes + 2));
+        for (int iclass = 0; iclass < mesh.I2EClass.size(); iclass++)
+        {
+            for (int i = 0; i < mesh.I2EClass[iclass].size(); i++)
+            {
+                int iedge = mesh.I2EClass[iclass][i];
+                int elem[2] = {mesh.I2E.elemL[iedge], mesh.I2E.elemR[iedge]};
+                for (int iside = 0; iside < 2; iside++)
+                {
+                    long long first_byte = (long long)elem[iside] * block_bytes;
+                    for (long long iline = first_byte / line_bytes; iline <= (first_byte + block_bytes - 1) / line_bytes; iline++)
+                        access.push_back(int(iline));
+                }
+            }
+        }
+        int num_access = access.size();
+        int num_line_total = int(((long long)mesh.num_element * block_bytes + line_bytes - 1) / line_bytes);
+        std::vector<int> tree(num_access + 1, 0);
+        std::vector<int> last_access(num_line_total, -1);
+        long long misses = 0;
+        int num_marked = 0;
+        for (int t = 0; t < num_access; t++)
+        {
+            int iline = access[t];
+            int t_last = last_access[iline];
+            if (t_last < 0)
+            {
+                misses++;
+            }
+            else
+            {
+                // Marked times up to t_last, the distinct blocks since are the marks after it
+                int marked_before = 0;
+                for (int i = t_last + 1; i > 0; i -= i & (-i))
+                    marked_before += tree[i];
+                if (num_marked - marked_before >= num_lines)
+                    misses++;
+                for (int i = t_last + 1; i <= num_access; i += i & (-i))
+                    tree[i]--;
+                num_marked--;
+            }
+            for (int i = t + 1; i <= num_access; i += i & (-i))
+                tree[i]++;
+            num_marked++;
+            last_access[iline] = t;
+        }
+        return misses;
+    }
+
+    bool ReorderMesh(TriMesh& mesh, const std::string& method, int block_bytes)
+    {
+        std::vector<int> order;
+        if (strcasecmp(method.c_str(), "rcm") == 0)
+        {
+            order = ElementOrderRCM(mesh);
+        }else if (strcasecmp(method.c_str(), "morton") == 0)
+        {
+            order = ElementOrderMorton(mesh);
+        }else if (strcasecmp(method.c_str(), "hilbert") == 0)
+        {
+            order = ElementOrderHilbert(mesh);
+        }else if (strcasecmp(method.c_str(), "none") == 0)
+        {
+            return false;
+        }else
+        {
+            std::cout << "Unknown mesh_ordering " << method << ", Aborting..." << std::endl;
+            abort();
+        }
+        double bandwidth = FaceBandwidth(mesh);
+        long long misses = FaceSweepMisses(mesh, block_bytes, page_bytes, num_pages);
+        mesh.Renumber(order);
+        double bandwidth_new = FaceBandwidth(mesh);
+        long long misses_new = FaceSweepMisses(mesh, block_bytes, page_bytes, num_pages);
+        std::cout << "Mesh ordering " << method << ": mean face bandwidth " << bandwidth << " -> " << bandwidth_new
+                  << ", face sweep misses of " << num_pages << " pages of " << (page_bytes >> 10) << " kB " << misses
+                  << " -> " << misses_new << " (" << double(misses) / std::max(misses_new, 1LL) << "x fewer)" << std::endl;
+        return true;
+    }
+
+} // namespace ordering
@@ -4,369 +4,118 @@ namespace ublas = boost::numeric::ublas;
 
 namespace solver{
 
-    ublas::vector<double> CalcResidual(TriMesh mesh, Param& param, ResData& resdata, ublas::vector<double> States, ublas::vector<double>& dt, int p)
+    // Gather the Nq geometry nodes of curved element ielem into nodes, (x, y) per node
+    static void GatherElementNodes(const TriMesh& mesh, int ielem, int Nq, double* nodes)
     {
-        // Unroll the mesh information
-        int num_element = mesh.num_element;
-        int num_states = 4; // Four states for 2D Euler equation
-        // The number of lagrange nodes in each element
-        int Np = int((p + 1) * (p + 2) / 2);
-        int Nq = mesh.E[mesh.CurvedElementIndex[0]].size();
-        int q = int((sqrt(1 + 8.0 * Nq) - 3) / 2);
-        double gamma = param.gamma;
-        // The residual vector
-        ublas::vector<double> Residual (num_element * Np * num_states, 0.0);
-        ublas::vector<double> mws_tally(num_element, 0.0);
-        // Pull out the ResData
-        arr_2d Phi = resdata.Phi;
-        arr_3d GPhi = resdata.GPhi;
-        arr_3d GPhi_Curved = resdata.GPhi_Curved;
-        arr_3d Phi_1D = resdata.Phi_1D;
-        arr_3d Phi_1D_Curved = resdata.Phi_1D_Curved;
-        arr_4d GPhi_1D = resdata.GPhi_1D;
-        arr_4d GPhi_1D_Curved = resdata.GPhi_1D_Curved;
-        int n_quad_1d = resdata.n_quad_1d;
-        int n_quad_2d = resdata.n_quad_2d;
-        ublas::vector<double> x_quad_1d = resdata.x_quad_1d;
-        ublas::vector<double> w_quad_1d = resdata.w_quad_1d;
-        ublas::vector<double> x_quad_2d = resdata.x_quad_2d;
-        ublas::vector<double> w_quad_2d = resdata.w_quad_2d;
+        for (int iq = 0; iq < Nq; iq++)
+        {
+            int inode = mesh.E.node[mesh.E.offset[ielem] + iq];
+            nodes[2 * iq] = mesh.V.x[inode];
+            nodes[2 * iq + 1] = mesh.V.y[inode];
+        }
+    }
 
+    // J = sum_iq x_iq (x) grad phi_iq of a curved element on point ig of quad_curved
+    static void CalcCurvedJacobian(const ResData& resdata, const double* nodes, int ig, double* J)
+    {
+        J[0] = 0.0; J[1] = 0.0; J[2] = 0.0; J[3] = 0.0;
+        for (int iq = 0; iq < resdata.Nq; iq++)
+        {
+            double gphi_xi = resdata.quad_curved.GPhi_Curved[ig][iq][0];
+            double gphi_eta = resdata.quad_curved.GPhi_Curved[ig][iq][1];
+            J[0] += nodes[2 * iq] * gphi_xi;     J[1] += nodes[2 * iq] * gphi_eta;
+            J[2] += nodes[2 * iq + 1] * gphi_xi; J[3] += nodes[2 * iq + 1] * gphi_eta;
+        }
+    }
+
+    ublas::vector<double> CalcResidual(const TriMesh& mesh, Param& param, const ResData& resdata, const ublas::vector<double>& States, ublas::vector<double>& dt, int p)
+    {
+        ublas::vector<double> Residual (States.size(), 0.0);
+        ublas::vector<double> mws_tally(mesh.num_element, 0.0);
+        CalcResidual(mesh, param, resdata, States, dt, p, Residual, mws_tally);
+        return Residual;
+    }
+
+    void CalcResidual(const TriMesh& mesh, Param& param, const ResData& resdata, const ublas::vector<double>& States, ublas::vector<double>& dt, int p,
+                      ublas::vector<double>& Residual, ublas::vector<double>& mws_tally, const kernels::StageUpdate* stage)
+    {
+        double gamma = param.gamma;
+        // Residual and mws_tally are sized by the caller and reused
         Residual.clear();
         mws_tally.clear();
 
-        // Loop over elements
-        // 1. Construct Jacobian 2.evealute interior contribution to the residual
+        // Loop over elements, evealute interior contribution to the residual
         // Notice that there are two sets of elements in the mesh, curved and not curved
-        for (int ielem_linear = 0; ielem_linear < mesh.LinearElementIndex.size(); ielem_linear++)
+        // The linear elements can use the quadrature-free path with the flux in nodal form
+        if (strcasecmp(param.volume_integration.c_str(), "nodal") == 0)
         {
-            int ielem = mesh.LinearElementIndex[ielem_linear];
-            // pull out the state from the big State vector on each lagrange node which will be used on
-            // interpolation to quadrature points
-            ublas::vector<ublas::vector<double> > states_in_element(Np, ublas::vector<double> (num_states, 0.0));
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> state(num_states);
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    state(istate) = States(ielem * Np * num_states + ip * num_states + istate);
-                }
-                states_in_element(ip) = state;
-            }
-            /*********************************************/
-            /* Interior Contribution from linear element */
-            /*********************************************/
-            // Construct the Jacobian matrix
-            ublas::matrix<double> jacobian = resdata.jacobian_in_linear_elements(ielem);
-            double det_jacobian = jacobian(0, 0) * jacobian(1, 1) - jacobian(0, 1) * jacobian(1, 0);
-            ublas::matrix<double> inv_jacobian = resdata.invjacobian_in_linear_elements(ielem);
-            // Do the integration using quadrature points, which is the interior contribution of the residual
-            for (int ip = 0; ip < Np; ip++) // loop over all lagrange nodes
-            {
-                ublas::vector<double> temp_sum (num_states, 0.0); // the temp summation for the quadrature integration
-                for (int ig = 0; ig < n_quad_2d; ig++) // loop over all quadrature points
-                {
-                    // interpolate the state to quadrature points
-                    ublas::vector<double> state_on_quad(num_states, 0.0);
-                    for (int ipi = 0; ipi < Np; ipi++)
-                    {
-                        for (int istate = 0; istate < num_states; istate++)
-                        {
-                            state_on_quad(istate) += Phi[ig][ipi] * states_in_element(ipi)(istate);
-                        }
-                    }
-                    ublas::matrix<double> analytical_flux = euler::CalcAnalyticalFlux(state_on_quad, gamma);
-                    ublas::vector<double> GPhi_on_quad (2, 0.0);
-                    GPhi_on_quad(0) = GPhi[ig][ip][0];
-                    GPhi_on_quad(1) = GPhi[ig][ip][1];
-                    ublas::vector<double> GPhi_matmul_invJ (2, 0.0);
-                    ublas::vector<double> GPhi_matmul_invJ_matmul_flux (4, 0.0);
-                    ublas::axpy_prod(GPhi_on_quad, inv_jacobian, GPhi_matmul_invJ, false);
-                    ublas::axpy_prod(GPhi_matmul_invJ, ublas::trans(analytical_flux), GPhi_matmul_invJ_matmul_flux, false);
-                    temp_sum += GPhi_matmul_invJ_matmul_flux * det_jacobian * w_quad_2d(ig);
-                }
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    // the contribution from interior, !!! substracted !!!
-                    Residual(ielem * Np * num_states + ip * num_states + istate) -= temp_sum(istate);
-                }
-            }
+            kernels::CalcVolumeResidualNodal(resdata, States, mesh.LinearElementIndex, gamma, Residual);
+        }else
+        {
+            kernels::CalcVolumeResidual(resdata, States, mesh.LinearElementIndex, false, gamma, Residual);
         }
+        kernels::CalcVolumeResidual(resdata, States, mesh.CurvedElementIndex, true, gamma, Residual);
 
+        // Loop through interior edges, calculate the edge flux
+        // With the colored face assembly, the edges of one color are processed concurrently
+        // The face kernels finish every element with its last edge: dtA and the stage update
+        bool colored = (strcasecmp(param.face_assembly.c_str(), "colored") == 0);
+        std::vector<unsigned char> faces_left(resdata.element_num_face);
+        kernels::ElementFinish finish = {param.cfl, &dt, stage, &faces_left};
+        kernels::CalcInteriorFaceResidual(mesh, resdata, States, gamma, colored, Residual, mws_tally, finish);
 
-        for (int ielem_curved = 0; ielem_curved < mesh.CurvedElementIndex.size(); ielem_curved++)
-        {
-            int ielem = mesh.CurvedElementIndex[ielem_curved];
-            // pull out the state from the big State vector on each lagrange node which will be used on
-            // interpolation to quadrature points
-            ublas::vector<ublas::vector<double> > states_in_element(Np, ublas::vector<double> (num_states, 0.0));
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> state(num_states);
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    state(istate) = States(ielem * Np * num_states + ip * num_states + istate);
-                }
-                states_in_element(ip) = state;
-            }
-            /*********************************************/
-            /* Interior Contribution from Curved element */
-            /*********************************************/
-            for (int ip = 0; ip < Np; ip++) // loop over all lagrange nodes
-            {
-                ublas::vector<double> temp_sum (num_states, 0.0); // the temp summation for the quadrature integration
-                for (int ig = 0; ig < n_quad_2d; ig++) // loop over all quadrature points
-                {
-                    // interpolate the state to quadrature points
-                    ublas::vector<double> state_on_quad(num_states, 0.0);
-                    for (int ipi = 0; ipi < Np; ipi++)
-                    {
-                        for (int istate = 0; istate < num_states; istate++)
-                        {
-                            state_on_quad(istate) += Phi[ig][ipi] * states_in_element(ipi)(istate);
-                        }
-                    }
-                    ublas::matrix<double> jacobian = resdata.jacobian_in_curved_elements(ielem, ig);
-                    double det_jacobian = jacobian(0, 0) * jacobian(1, 1) - jacobian(0, 1) * jacobian(1, 0);
-                    ublas::matrix<double> inv_jacobian = resdata.invjacobian_in_curved_elements(ielem, ig);
-
-                    ublas::matrix<double> analytical_flux = euler::CalcAnalyticalFlux(state_on_quad, gamma);
-                    ublas::vector<double> GPhi_on_quad (2, 0.0);
-                    GPhi_on_quad(0) = GPhi[ig][ip][0]; GPhi_on_quad(1) = GPhi[ig][ip][1];
-                    ublas::vector<double> GPhi_matmul_invJ (2, 0.0);
-                    ublas::vector<double> GPhi_matmul_invJ_matmul_flux (4, 0.0);
-                    ublas::axpy_prod(GPhi_on_quad, inv_jacobian, GPhi_matmul_invJ, false);
-                    ublas::axpy_prod(GPhi_matmul_invJ, ublas::trans(analytical_flux), GPhi_matmul_invJ_matmul_flux, false);
-                    temp_sum += GPhi_matmul_invJ_matmul_flux * det_jacobian * w_quad_2d(ig);
-                }
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    // the contribution from interior, !!! substracted !!!
-                    Residual(ielem * Np * num_states + ip * num_states + istate) -= temp_sum(istate);
-                }
-            }
-        } // End Loop over elements
+        // Loop through the boundary edges, curved edges first
+        kernels::CalcBoundaryFaceResidual(mesh, resdata, States, colored, Residual, mws_tally, finish);
+    }
 
-        // Loop through interior edges, calculate the edge flux
-        for (int iedge = 0; iedge < mesh.I2E.size(); iedge++)
-        {
-            double mws_recorded = 0.0;
-            int ielemL = mesh.I2E[iedge][0] - 1; int ielemR = mesh.I2E[iedge][2] - 1;
-            int ilocL = mesh.I2E[iedge][1] - 1; int ilocR = mesh.I2E[iedge][3] - 1;
-            ublas::vector<ublas::vector<double> > uL(Np, ublas::vector<double> (num_states, 0.0));
-            ublas::vector<ublas::vector<double> > uR(Np, ublas::vector<double> (num_states, 0.0));
-            ublas::vector<double> norm_vec(2, 0.0);
-            norm_vec(0) = mesh.In[iedge][0];
-            norm_vec(1) = mesh.In[iedge][1];
-            double jacobian_edge = mesh.In[iedge][2];
-            double mws = 0.0;
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> stateL(num_states);
-                ublas::vector<double> stateR(num_states);
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    stateL(istate) = States(ielemL * Np * num_states + ip * num_states + istate);
-                    stateR(istate) = States(ielemR * Np * num_states + ip * num_states + istate);
-                }
-                uL(ip) = stateL;
-                uR(ip) = stateR;
-            }
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> temp_sum_R (num_states, 0.0);
-                ublas::vector<double> temp_sum_L (num_states, 0.0); // the temp summation for the quadrature integration
-                // Now do the integration using 1d quad points
-                for (int ig = 0; ig < n_quad_1d; ig++)
-                {
-                    // interpolate the LEFT and RIGHT state to a certain quadrature point
-                    ublas::vector<double> uL_quad (num_states, 0.0), uR_quad (num_states, 0.0);
-                    for (int ipi = 0; ipi < Np; ipi++)
-                    {
-                        uL_quad += Phi_1D[ilocL][ig][ipi] * uL(ipi);
-                        uR_quad += Phi_1D[ilocR][n_quad_1d - 1 - ig][ipi] * uR(ipi);
-                    }
-                    ublas::vector<double> numerical_flux = euler::CalcNumericalFlux(uL_quad, uR_quad, norm_vec, gamma, "roe", mws);
-                    if (mws_recorded < mws)
-                        mws_recorded = mws;
-                    temp_sum_L += Phi_1D[ilocL][ig][ip] * numerical_flux * jacobian_edge * w_quad_1d(ig);
-                    temp_sum_R -= Phi_1D[ilocR][n_quad_1d - 1 - ig][ip] * numerical_flux * jacobian_edge * w_quad_1d(ig);
-                }
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    // the contribution from edge, !!! ADD !!!
-                    Residual(ielemL * Np * num_states + ip * num_states + istate) += temp_sum_L(istate);
-                    Residual(ielemR * Np * num_states + ip * num_states + istate) += temp_sum_R(istate);
-                }
-            }
-            mws_tally(ielemL) += mws_recorded * jacobian_edge;
-            mws_tally(ielemR) += mws_recorded * jacobian_edge;
-        }
 
-        // Loop through the boundary curved edges
-        for (int iedge_curved = 0; iedge_curved < mesh.CurvedEdgeIndex.size(); iedge_curved++)
-        {
-            int iedge = mesh.CurvedEdgeIndex[iedge_curved];
-            int ielemL = mesh.B2E[iedge][0] - 1;
-            int ilocL = mesh.B2E[iedge][1] - 1;
-            ublas::vector<ublas::vector<double> > uL(Np, ublas::vector<double> (num_states, 0.0));
-            string boundary_type;
-            boundary_type = param.bound0;
-            double mws = 0.0, mws_recorded = 0.0;
-            double jacobian_edge, jacobian_edge_recorded = 0.0;
-            // Get the boundary type
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> stateL(num_states);
-                ublas::vector<double> stateR(num_states);
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    stateL(istate) = States(ielemL * Np * num_states + ip * num_states + istate);
-                }
-                uL(ip) = stateL;
-            } // Got the inside state vector
-            // Get the geometry points on the edge
-            ublas::vector<ublas::vector<double> > edge_coord = geometry::GetEdgeCoordinates(mesh, iedge);
-            ublas::vector<int> edge_coord_ind = geometry::GetEdgeCoordinatesIndex(mesh, iedge);
-            ublas::vector<ublas::vector<double> > norm_on_quad_curved(n_quad_1d, ublas::vector<double> (2));
-            for (int ig = 0; ig < n_quad_1d; ig++)
-            {
-                ublas::vector<double> tangent(2, 0.0);
-                for (int iq = 0; iq < q + 1; iq++)
-                {
-                    int local_lagrange_ind = edge_coord_ind(iq);
-                    double deriv_along_edge = 0.0;
-                    switch (ilocL)
-                    {
-                        case 0:
-                            tangent(0) += - edge_coord(iq)(0) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0]
-                                        + edge_coord(iq)(0) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
-                            tangent(1) += - edge_coord(iq)(1) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0]
-                                        + edge_coord(iq)(1) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
-                            break;
-                        case 1:
-                            deriv_along_edge = -GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
-                            tangent(0) += edge_coord(iq)(0) * deriv_along_edge;
-                            tangent(1) += edge_coord(iq)(1) * deriv_along_edge;
-                            break;
-                        case 2:
-                            deriv_along_edge = GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0];
-                            tangent(0) += edge_coord(iq)(0) * deriv_along_edge;
-                            tangent(1) += edge_coord(iq)(1) * deriv_along_edge;
-                            break;
-                        default:
-                            break;
-                    }
-                }
-                norm_on_quad_curved(ig)(0) = tangent(1);
-                norm_on_quad_curved(ig)(1) = -1.0 * tangent(0);
-            }
+    void CalcQuadRule2D(int quad_order, int p, int q, QuadRule2D& rule)
+    {
+        int Np = int((p + 1) * (p + 2) / 2);
+        int Nq = int((q + 1) * (q + 2) / 2);
+        ublas::matrix<double> TriLagrangeCoeff = lagrange::TriangleLagrange2D(p);
+        ublas::matrix<double> TriLagrangeCoeff_Curved = lagrange::TriangleLagrange2D(q);
 
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> temp_sum_L (num_states, 0.0); // the temp summation for the quadrature integration
-                // Now do the integration using 1d quad points
-                for (int ig = 0; ig < n_quad_1d; ig++)
-                {
-                    // interpolate the LEFT and RIGHT state to a certain quadrature point
-                    ublas::vector<double> uL_quad (num_states, 0.0);
-                    for (int ipi = 0; ipi < Np; ipi++)
-                    {
-                        uL_quad += Phi_1D[ilocL][ig][ipi] * uL(ipi);
-                    }
-                    // Apply the boudary condition
-                    jacobian_edge = ublas::norm_2(norm_on_quad_curved(ig));
-                    if (jacobian_edge > jacobian_edge_recorded)
-                        jacobian_edge_recorded = jacobian_edge;
-                    ublas::vector<double> norm_vec = norm_on_quad_curved(ig) / jacobian_edge;
-                    ublas::vector<double> numerical_flux = euler::ApplyBoundaryCondition(uL_quad, norm_vec, boundary_type, param, mws);
-                    if (mws_recorded < mws)
-                        mws_recorded = mws;
-                    temp_sum_L += Phi_1D[ilocL][ig][ip] * numerical_flux * jacobian_edge * w_quad_1d(ig);
-                }
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    // the contribution from edge, !!! ADD !!!
-                    Residual(ielemL * Np * num_states + ip * num_states + istate) += temp_sum_L(istate);
-                }
-            }
-            mws_tally(ielemL) += mws_recorded * jacobian_edge_recorded;
-        }
+        int n_quad_2d;
+        std::vector<double> x_quad_2d_std, w_quad_2d_std;
+        GetQuadraturePointsWeight2D(quad_order, n_quad_2d, x_quad_2d_std, w_quad_2d_std);
+        ublas::vector<double> x_quad_2d = utils::StdToBoostVector(x_quad_2d_std);
+        rule.order = quad_order;
+        rule.n_quad = n_quad_2d;
+        rule.x_quad = x_quad_2d;
+        rule.w_quad = utils::StdToBoostVector(w_quad_2d_std);
 
-        for (int iedge_linear = 0; iedge_linear < mesh.LinearEdgeIndex.size(); iedge_linear++)
+        rule.Phi.resize(boost::extents[n_quad_2d][Np]);
+        rule.Phi_Curved.resize(boost::extents[n_quad_2d][Nq]);
+        rule.GPhi.resize(boost::extents[n_quad_2d][Np][2]);
+        rule.GPhi_Curved.resize(boost::extents[n_quad_2d][Nq][2]);
+        rule.GPhi_T.resize(boost::extents[Np][2 * n_quad_2d]);
+        for (int ig = 0; ig < n_quad_2d; ig++) // for each quadrature point
         {
-            int iedge = mesh.LinearEdgeIndex[iedge_linear];
-            int ielemL = mesh.B2E[iedge][0] - 1;
-            int ilocL = mesh.B2E[iedge][1] - 1;
-            ublas::vector<ublas::vector<double> > uL(Np, ublas::vector<double> (num_states, 0.0));
-            string boundary_type;
-            double mws = 0.0, mws_recorded = 0.0;
-            // Get the boundary type
-            switch (mesh.B2E[iedge][2])
+            double xi = x_quad_2d[2 * ig];
+            double eta = x_quad_2d[2 * ig + 1];
+            ublas::matrix<double> gphi = lagrange::CalcBaseFunctionGradient(TriLagrangeCoeff, xi, eta);
+            ublas::vector<double> phi = lagrange::CalcBaseFunction(TriLagrangeCoeff, xi, eta);
+            for (int ipi = 0; ipi < Np; ipi++)
             {
-                case 1:
-                boundary_type = param.bound0;
-                    break;
-                case 2:
-                boundary_type = param.bound1;
-                    break;
-                case 3:
-                boundary_type = param.bound2;
-                    break;
-                case 4:
-                boundary_type = param.bound3;
-                    break;
+                rule.Phi[ig][ipi] = phi(ipi);
+                rule.GPhi[ig][ipi][0] = gphi(ipi, 0);
+                rule.GPhi[ig][ipi][1] = gphi(ipi, 1);
+                rule.GPhi_T[ipi][2 * ig] = gphi(ipi, 0);
+                rule.GPhi_T[ipi][2 * ig + 1] = gphi(ipi, 1);
             }
-            for (int ip = 0; ip < Np; ip++)
-            {
-                ublas::vector<double> stateL(num_states);
-                ublas::vector<double> stateR(num_states);
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    stateL(istate) = States(ielemL * Np * num_states + ip * num_states + istate);
-                }
-                uL(ip) = stateL;
-            } // Got the inside state vector
-            ublas::vector<double> norm_vec(2, 0.0);
-            norm_vec(0) = mesh.Bn[iedge][0];
-            norm_vec(1) = mesh.Bn[iedge][1];
-            double jacobian_edge = mesh.Bn[iedge][2];
-            for (int ip = 0; ip < Np; ip++)
+            ublas::vector<double> phi_curved = lagrange::CalcBaseFunction(TriLagrangeCoeff_Curved, xi, eta);
+            ublas::matrix<double> gphi_curved = lagrange::CalcBaseFunctionGradient(TriLagrangeCoeff_Curved, xi, eta);
+            for (int ipi = 0; ipi < Nq; ipi++)
             {
-                ublas::vector<double> temp_sum_L (num_states, 0.0); // the temp summation for the quadrature integration
-                // Now do the integration using 1d quad points
-                for (int ig = 0; ig < n_quad_1d; ig++)
-                {
-                    // interpolate the LEFT and RIGHT state to a certain quadrature point
-                    ublas::vector<double> uL_quad (num_states, 0.0);
-                    for (int ipi = 0; ipi < Np; ipi++)
-                    {
-                        uL_quad += Phi_1D[ilocL][ig][ipi] * uL(ipi);
-                    }
-                    // Apply the boudary condition
-                    ublas::vector<double> numerical_flux = euler::ApplyBoundaryCondition(uL_quad, norm_vec, boundary_type, param, mws);
-                    if (mws_recorded < mws)
-                        mws_recorded = mws;
-                    temp_sum_L += Phi_1D[ilocL][ig][ip] * numerical_flux * jacobian_edge * w_quad_1d(ig);
-                }
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    // the contribution from edge, !!! ADD !!!
-                    Residual(ielemL * Np * num_states + ip * num_states + istate) += temp_sum_L(istate);
-                }
+                rule.Phi_Curved[ig][ipi] = phi_curved(ipi);
+                rule.GPhi_Curved[ig][ipi][0] = gphi_curved(ipi, 0);
+                rule.GPhi_Curved[ig][ipi][1] = gphi_curved(ipi, 1);
             }
-            mws_tally(ielemL) += mws_recorded * jacobian_edge;
-        }
-        // Calculate dtA
-        for (int i = 0; i < num_element; i++)
-        {
-            dt(i) = 2.0 * mesh.Area[i] * param.cfl / mws_tally(i);
         }
-        return Residual;
     }
 
-
-    void CalcResData(TriMesh mesh, int p, ResData& resdata)
+    void CalcResData(const TriMesh& mesh, int p, const Param& param, ResData& resdata)
     {
         int Np = int((p + 1) * (p + 2) / 2);
         int Nq = mesh.E[mesh.CurvedElementIndex[0]].size();
@@ -374,61 +123,52 @@ namespace solver{
         ublas::matrix<double> TriLagrangeCoeff = lagrange::TriangleLagrange2D(p);
         ublas::matrix<double> TriLagrangeCoeff_Curved = lagrange::TriangleLagrange2D(q);
 
-        int n_quad_1d, n_quad_2d;
-        std::vector<double> x_quad_1d_std, w_quad_1d_std, x_quad_2d_std, w_quad_2d_std;
-        GetQuadraturePointsWeight1D(9, n_quad_1d,  x_quad_1d_std, w_quad_1d_std); // order 9 is sufficient
-        GetQuadraturePointsWeight2D(9, n_quad_2d, x_quad_2d_std, w_quad_2d_std);
+        // Quadrature orders: 2p + 1 on linear elements, raised by the degree of detJ, 2 (q - 1), on
+        // curved elements and by the degree of the surface jacobian, q - 1, on the edges.
+        // A positive quad_order_* in PARAM.in overrides the automatic choice.
+        int quad_order_linear = param.quad_order_linear > 0 ? param.quad_order_linear : 2 * p + 1;
+        int quad_order_curved = param.quad_order_curved > 0 ? param.quad_order_curved : 2 * p + 1 + 2 * (q - 1);
+        int quad_order_1d = param.quad_order_face > 0 ? param.quad_order_face : 2 * p + 1 + (q - 1);
+        CalcQuadRule2D(quad_order_linear, p, q, resdata.quad_linear);
+        CalcQuadRule2D(quad_order_curved, p, q, resdata.quad_curved);
+
+        int n_quad_1d;
+        std::vector<double> x_quad_1d_std, w_quad_1d_std;
+        GetQuadraturePointsWeight1D(quad_order_1d, n_quad_1d,  x_quad_1d_std, w_quad_1d_std);
         ublas::vector<double> x_quad_1d = utils::StdToBoostVector(x_quad_1d_std);
         ublas::vector<double> w_quad_1d = utils::StdToBoostVector(w_quad_1d_std);
-        ublas::vector<double> x_quad_2d = utils::StdToBoostVector(x_quad_2d_std);
-        ublas::vector<double> w_quad_2d = utils::StdToBoostVector(w_quad_2d_std);
 
+        resdata.quad_order_1d = quad_order_1d;
         resdata.n_quad_1d = n_quad_1d;
-        resdata.n_quad_2d = n_quad_2d;
         resdata.x_quad_1d = x_quad_1d;
         resdata.w_quad_1d = w_quad_1d;
-        resdata.x_quad_2d = x_quad_2d;
-        resdata.w_quad_2d = w_quad_2d;
         resdata.Np = Np;
         resdata.Nq = Nq;
+        // Select the residual kernels once, specialized on (p, q) where available
+        resdata.kernel_set = kernels::SelectKernelSet(p, q);
 
-        arr_2d Phi(boost::extents[n_quad_2d][Np]); resdata.Phi.resize(boost::extents[n_quad_2d][Np]);
-        arr_2d Phi_Curved(boost::extents[n_quad_2d][Nq]); resdata.Phi_Curved.resize(boost::extents[n_quad_2d][Nq]);
-        arr_3d GPhi(boost::extents[n_quad_2d][Np][2]); resdata.GPhi.resize(boost::extents[n_quad_2d][Np][2]);
-        arr_3d GPhi_Curved(boost::extents[n_quad_2d][Nq][2]); resdata.GPhi_Curved.resize(boost::extents[n_quad_2d][Nq][2]);
-        // Pre-calculate the basis functions on edge quad nodes
-        arr_3d Phi_1D(boost::extents[3][n_quad_1d][Np]); resdata.Phi_1D.resize(boost::extents[3][n_quad_1d][Np]);
-        arr_3d Phi_1D_Curved(boost::extents[3][n_quad_1d][Nq]); resdata.Phi_1D_Curved.resize(boost::extents[3][n_quad_1d][Nq]);
-        arr_4d GPhi_1D(boost::extents[3][n_quad_1d][Np][2]); resdata.GPhi_1D.resize(boost::extents[3][n_quad_1d][Np][2]);
-        arr_4d GPhi_1D_Curved(boost::extents[3][n_quad_1d][Nq][2]); resdata.GPhi_1D_Curved.resize(boost::extents[3][n_quad_1d][Nq][2]);
-
-        for (int ig = 0; ig < n_quad_2d; ig++) // for each quadrature point
+        // Reference stiffness matrices of the quadrature-free volume path, exact with a rule of order 2p
+        QuadRule2D rule_stiff;
+        CalcQuadRule2D(2 * p, p, q, rule_stiff);
+        resdata.Stiff_T.resize(boost::extents[Np][2 * Np]);
+        std::fill(resdata.Stiff_T.data(), resdata.Stiff_T.data() + resdata.Stiff_T.num_elements(), 0.0);
+        for (int ig = 0; ig < rule_stiff.n_quad; ig++)
         {
-            double xi = x_quad_2d[2 * ig];
-            double eta = x_quad_2d[2 * ig + 1];
-            ublas::matrix<double> gphi = lagrange::CalcBaseFunctionGradient(TriLagrangeCoeff, xi, eta);
-            ublas::vector<double> phi = lagrange::CalcBaseFunction(TriLagrangeCoeff, xi, eta);
-            for (int ipi = 0; ipi < Np; ipi++)
+            for (int ip = 0; ip < Np; ip++)
             {
-                Phi[ig][ipi] = phi(ipi);
-                GPhi[ig][ipi][0] = gphi(ipi, 0);
-                GPhi[ig][ipi][1] = gphi(ipi, 1);
+                for (int jp = 0; jp < Np; jp++)
+                {
+                    resdata.Stiff_T[ip][2 * jp] += rule_stiff.GPhi[ig][ip][0] * rule_stiff.Phi[ig][jp] * rule_stiff.w_quad(ig);
+                    resdata.Stiff_T[ip][2 * jp + 1] += rule_stiff.GPhi[ig][ip][1] * rule_stiff.Phi[ig][jp] * rule_stiff.w_quad(ig);
+                }
             }
         }
 
-        for (int ig = 0; ig < n_quad_2d; ig++) // for each quadrature point
-        {
-            double xi = x_quad_2d[2 * ig];
-            double eta = x_quad_2d[2 * ig + 1];
-            ublas::vector<double> phi_curved = lagrange::CalcBaseFunction(TriLagrangeCoeff_Curved, xi, eta);
-            ublas::matrix<double> gphi_curved = lagrange::CalcBaseFunctionGradient(TriLagrangeCoeff_Curved, xi, eta);
-            for (int ipi = 0; ipi < Nq; ipi++)
-            {
-                Phi_Curved[ig][ipi] = phi_curved(ipi);
-                GPhi_Curved[ig][ipi][0] = gphi_curved(ipi, 0);
-                GPhi_Curved[ig][ipi][1] = gphi_curved(ipi, 1);
-            }
-        }
+        // Pre-calculate the basis functions on edge quad nodes
+        arr_3d Phi_1D(boost::extents[3][n_quad_1d][Np]); resdata.Phi_1D.resize(boost::extents[3][n_quad_1d][Np]);
+        arr_3d Phi_1D_Curved(boost::extents[3][n_quad_1d][Nq]); resdata.Phi_1D_Curved.resize(boost::extents[3][n_quad_1d][Nq]);
+        arr_4d GPhi_1D(boost::extents[3][n_quad_1d][Np][2]); resdata.GPhi_1D.resize(boost::extents[3][n_quad_1d][Np][2]);
+        arr_4d GPhi_1D_Curved(boost::extents[3][n_quad_1d][Nq][2]); resdata.GPhi_1D_Curved.resize(boost::extents[3][n_quad_1d][Nq][2]);
 
         for (int num_edge = 0; num_edge < 3; num_edge++)
         {
@@ -465,173 +205,285 @@ namespace solver{
                 }
             }
         }
-        // Calculate the jacobian in curved elements on quadrature nodes
-        ublas::matrix<ublas::matrix<double> > jacobian_curved(mesh.E.size(), n_quad_2d, ublas::matrix<double> (2, 2, 0.0));
-        ublas::matrix<ublas::matrix<double> > inv_jacobian_curved(mesh.E.size(), n_quad_2d, ublas::matrix<double> (2, 2, 0.0));
-        ublas::vector<ublas::matrix<double> > jacobian_linear(mesh.E.size(), ublas::matrix<double> (2, 2, 0.0));
-        ublas::vector<ublas::matrix<double> > inv_jacobian_linear(mesh.E.size(), ublas::matrix<double> (2, 2, 0.0));
+        // Calculate the jacobian of the linear elements, and of the curved elements on quadrature nodes.
+        // Both are stored flat, the curved ones indexed by the position in mesh.CurvedElementIndex.
+        int num_curved_element = mesh.CurvedElementIndex.size();
+        int n_quad_curved = resdata.quad_curved.n_quad;
+        resdata.curved_element_ordinal.assign(mesh.E.size(), -1);
+        for (int icurved = 0; icurved < num_curved_element; icurved++)
+        {
+            resdata.curved_element_ordinal[mesh.CurvedElementIndex[icurved]] = icurved;
+        }
+        resdata.element_num_face.assign(mesh.E.size(), 0);
+        for (int iedge = 0; iedge < mesh.I2E.size(); iedge++)
+        {
+            resdata.element_num_face[mesh.I2E.elemL[iedge]]++;
+            resdata.element_num_face[mesh.I2E.elemR[iedge]]++;
+        }
+        for (int iedge = 0; iedge < mesh.B2E.size(); iedge++)
+        {
+            resdata.element_num_face[mesh.B2E.elemL[iedge]]++;
+        }
+        resdata.jacobian_linear.assign(4 * mesh.E.size(), 0.0);
+        resdata.jacobian_curved.resize(4 * num_curved_element * n_quad_curved);
+        #pragma omp parallel for schedule(dynamic, 64)
         for (int ielem = 0; ielem < mesh.E.size(); ielem++)
         {
             if (mesh.isCurved[ielem])
             {
-                for (int ig = 0; ig < n_quad_2d; ig++)
+                // Gather the geometry nodes once, then J = sum_iq x_iq (x) grad phi_iq on every point
+                int icurved = resdata.curved_element_ordinal[ielem];
+                std::vector<double> nodes (2 * Nq);
+                GatherElementNodes(mesh, ielem, Nq, &nodes[0]);
+                for (int ig = 0; ig < n_quad_curved; ig++)
                 {
-                    ublas::matrix<double> jacobian(2, 2, 0.0), inv_jacobian(2, 2, 0.0);
-                    jacobian = geometry::CalcJacobianCurved(mesh, ielem, GPhi_Curved, n_quad_2d, ig);
-                    inv_jacobian = utils::Invert22Matrix(jacobian);
-                    jacobian_curved(ielem, ig) = jacobian;
-                    inv_jacobian_curved(ielem, ig) = inv_jacobian;
-
+                    CalcCurvedJacobian(resdata, &nodes[0], ig, &resdata.jacobian_curved[4 * (icurved * n_quad_curved + ig)]);
                 }
             }
             else
             {
-                ublas::matrix<double> jacobian(2, 2, 0.0), inv_jacobian(2, 2, 0.0);
-                jacobian = geometry::CalcJacobianLinear(mesh, ielem);
-                inv_jacobian = utils::Invert22Matrix(jacobian);
-                jacobian_linear(ielem) = jacobian;
-                inv_jacobian_linear(ielem) = inv_jacobian;
+                ublas::matrix<double> jacobian = geometry::CalcJacobianLinear(mesh, ielem);
+                double* J = &resdata.jacobian_linear[4 * ielem];
+                J[0] = jacobian(0, 0); J[1] = jacobian(0, 1);
+                J[2] = jacobian(1, 0); J[3] = jacobian(1, 1);
             }
         }
 
-        resdata.jacobian_in_curved_elements = jacobian_curved;
-        resdata.jacobian_in_linear_elements = jacobian_linear;
-        resdata.invjacobian_in_curved_elements = inv_jacobian_curved;
-        resdata.invjacobian_in_linear_elements = inv_jacobian_linear;
-        resdata.Phi = Phi;
-        resdata.Phi_Curved = Phi_Curved;
-        resdata.GPhi = GPhi;
-        resdata.GPhi_Curved = GPhi_Curved;
         resdata.Phi_1D = Phi_1D;
+        resdata.Phi_1D_Reversed.resize(boost::extents[3][n_quad_1d][Np]);
+        for (int num_edge = 0; num_edge < 3; num_edge++)
+        {
+            for (int ig = 0; ig < n_quad_1d; ig++)
+            {
+                for (int ip = 0; ip < Np; ip++)
+                {
+                    resdata.Phi_1D_Reversed[num_edge][ig][ip] = Phi_1D[num_edge][n_quad_1d - 1 - ig][ip];
+                }
+            }
+        }
         resdata.Phi_1D_Curved = Phi_1D_Curved;
         resdata.GPhi_1D = GPhi_1D;
         resdata.GPhi_1D_Curved = GPhi_1D_Curved;
 
-    }
-
-        ublas::vector<double> TimeMarching_TVDRK3(TriMesh mesh, Param& param, ResData& resdata, ublas::vector<double> States_old, ublas::vector<ublas::matrix<double> > invM, int p, int& converged, double& norm_residual)
-    {
-        ublas::vector<double> States_new = States_old;
-        ublas::vector<double> States_1 = States_old * 0.0;
-        ublas::vector<double> States_2 = States_old * 0.0;
-        ublas::vector<double> Residual_1(States_old.size(), 0.0);
-        ublas::vector<double> Residual_2(States_old.size(), 0.0);
-        int num_elements = invM.size(); int num_states = 4;
-        int Np = int((p + 1) * (p + 2) / 2);
-        double eps = param.eps;
-        converged = 0;
-        ublas::vector<double> dt (num_elements, 0.0), dt_temp (num_elements, 0.0);
-        ublas::vector<double> Residual = CalcResidual(mesh, param, resdata, States_old, dt, p); // Caculate the residual, and the time step
-        // Caculate the 1st state in TVDRK3, the first step
-        for (int ielem = 0; ielem < num_elements; ielem++)
+        // Normals, surface jacobians and x coordinates on the quadrature points of the curved boundary edges
+        int num_curved_edge = mesh.CurvedEdgeIndex.size();
+        resdata.curved_edge_ordinal.assign(mesh.B2E.size(), -1);
+        resdata.curved_edge_normal.resize(2 * num_curved_edge * n_quad_1d);
+        resdata.curved_edge_jacobian.resize(num_curved_edge * n_quad_1d);
+        resdata.curved_edge_x.resize(num_curved_edge * n_quad_1d);
+        #pragma omp parallel for
+        for (int iedge_curved = 0; iedge_curved < num_curved_edge; iedge_curved++)
         {
-            // Get the states in this element
-            ublas::matrix<double> u(Np, num_states, 0.0);
-            ublas::matrix<double> R(Np, num_states, 0.0);
-            ublas::matrix<double> u_1(Np, num_states, 0.0);
-            for (int ip = 0; ip < Np; ip++)
+            int iedge = mesh.CurvedEdgeIndex[iedge_curved];
+            int ilocL = mesh.B2E.locL[iedge];
+            resdata.curved_edge_ordinal[iedge] = iedge_curved;
+            // Get the geometry points on the edge
+            ublas::vector<ublas::vector<double> > edge_coord = geometry::GetEdgeCoordinates(mesh, iedge);
+            ublas::vector<int> edge_coord_ind = geometry::GetEdgeCoordinatesIndex(mesh, iedge);
+            for (int ig = 0; ig < n_quad_1d; ig++)
             {
-                for (int istate = 0; istate < num_states; istate++)
+                double tangent[2] = {0.0, 0.0};
+                double quad_x = 0.0;
+                for (int iq = 0; iq < q + 1; iq++)
                 {
-                    u(ip, istate) = States_old(ielem * Np * num_states + ip * num_states + istate);
-                    R(ip, istate) = Residual(ielem * Np * num_states + ip * num_states + istate);
-                }
+                    int local_lagrange_ind = edge_coord_ind(iq);
+                    double deriv_along_edge = 0.0;
+                    switch (ilocL)
+                    {
+                        case 0:
+                            tangent[0] += - edge_coord(iq)(0) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0]
+                                        + edge_coord(iq)(0) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
+                            tangent[1] += - edge_coord(iq)(1) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0]
+                                        + edge_coord(iq)(1) * GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
+                            break;
+                        case 1:
+                            deriv_along_edge = -GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
+                            tangent[0] += edge_coord(iq)(0) * deriv_along_edge;
+                            tangent[1] += edge_coord(iq)(1) * deriv_along_edge;
+                            break;
+                        case 2:
+                            deriv_along_edge = GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0];
+                            tangent[0] += edge_coord(iq)(0) * deriv_along_edge;
+                            tangent[1] += edge_coord(iq)(1) * deriv_along_edge;
+                            break;
+                        default:
+                            break;
+                    }
+                    quad_x += - edge_coord(iq)(0) * Phi_1D_Curved[ilocL][ig][local_lagrange_ind];
+                }
+                int k = iedge_curved * n_quad_1d + ig;
+                double jacobian_edge = sqrt(tangent[1] * tangent[1] + tangent[0] * tangent[0]);
+                resdata.curved_edge_jacobian[k] = jacobian_edge;
+                resdata.curved_edge_normal[2 * k] = tangent[1] / jacobian_edge;
+                resdata.curved_edge_normal[2 * k + 1] = -1.0 * tangent[0] / jacobian_edge;
+                resdata.curved_edge_x[k] = quad_x;
             }
-            ublas::matrix<double> invM_mul_R(Np, num_states, 0.0);
-            ublas::axpy_prod(invM(ielem), R, invM_mul_R, false);
-            u_1 = u - dt(ielem) * invM_mul_R;
-            // Apply the values of u_FE to the long vector State_FE
-            for (int ip = 0; ip < Np; ip++)
+        }
+
+    }
+
+    void CalcBoundaryConditions(const TriMesh& mesh, Param& param, ResData& resdata)
+    {
+        // Resolve the boundary condition of every boundary group once
+        resdata.boundary_conditions.clear();
+        for (int igroup = 0; igroup < int(mesh.num_boundary); igroup++)
+        {
+            if (igroup >= param.bound.size() || param.bound[igroup].empty())
             {
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    States_1(ielem * Np * num_states + ip * num_states + istate) = u_1(ip, istate);
-                }
+                std::cout << "No boundary condition bound" << igroup << " for boundary " << mesh.Bname[igroup] << " Aborting..." << std::endl;
+                abort();
             }
+            resdata.boundary_conditions.push_back(euler::SetupBoundaryCondition(param.bound[igroup], param));
         }
-        Residual_1  = CalcResidual(mesh, param, resdata, States_1, dt_temp, p);
-        // The second step of RK3
-        for (int ielem = 0; ielem < num_elements; ielem++)
+    }
+
+    void CalcMetricCache(const TriMesh& mesh, Param& param, ResData& resdata)
+    {
+        // The volume kernel needs invJ detJ w = adj(J) w on every quadrature point.
+        // The full policy stores it per element and quadrature point, the compact policy stores
+        // adj(J) once per linear element and the geometry nodes of the curved elements only.
+        int num_element = mesh.E.size();
+        int n_quad_linear = resdata.quad_linear.n_quad;
+        int n_quad_curved = resdata.quad_curved.n_quad;
+        int Nq = resdata.Nq;
+        resdata.metric_compact = (strcasecmp(param.metric_storage.c_str(), "compact") == 0);
+        resdata.metric.clear();
+        resdata.metric_curved.clear();
+        resdata.curved_element_nodes.clear();
+        if (resdata.metric_compact)
         {
-            // check if an element is converged
-            // Get the states in this element
-            ublas::matrix<double> u(Np, num_states, 0.0);
-            ublas::matrix<double> R(Np, num_states, 0.0);
-            ublas::matrix<double> u_1(Np, num_states, 0.0);
-            ublas::matrix<double> u_2(Np, num_states, 0.0);
-            for (int ip = 0; ip < Np; ip++)
+            resdata.metric.assign(4 * num_element, 0.0);
+            #pragma omp parallel for
+            for (int i_linear_elem = 0; i_linear_elem < mesh.LinearElementIndex.size(); i_linear_elem++)
             {
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    u(ip, istate) = States_old(ielem * Np * num_states + ip * num_states + istate);
-                    u_1(ip, istate) = States_1(ielem * Np * num_states + ip * num_states + istate);
-                    R(ip, istate) = Residual_1(ielem * Np * num_states + ip * num_states + istate);
-                }
+                int ielem = mesh.LinearElementIndex[i_linear_elem];
+                const double* J = &resdata.jacobian_linear[4 * ielem];
+                double* M = &resdata.metric[4 * ielem];
+                M[0] = J[3];  M[1] = -J[1];
+                M[2] = -J[2]; M[3] = J[0];
             }
-            ublas::matrix<double> invM_mul_R(Np, num_states, 0.0);
-            ublas::axpy_prod(invM(ielem), R, invM_mul_R, false);
-            u_2 = 0.75 * u + 0.25 * u_1  - 0.25 * dt(ielem) * invM_mul_R;
-            // Apply the values of u_FE to the long vector State_FE
-            for (int ip = 0; ip < Np; ip++)
+            resdata.curved_element_nodes.resize(2 * Nq * mesh.CurvedElementIndex.size());
+            #pragma omp parallel for
+            for (int icurved = 0; icurved < mesh.CurvedElementIndex.size(); icurved++)
             {
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    States_2(ielem * Np * num_states + ip * num_states + istate) = u_2(ip, istate);
-                }
+                GatherElementNodes(mesh, mesh.CurvedElementIndex[icurved], Nq, &resdata.curved_element_nodes[2 * Nq * icurved]);
             }
+            return;
         }
-        Residual_2  = CalcResidual(mesh, param, resdata, States_2, dt_temp, p);
-        for (int ielem = 0; ielem < num_elements; ielem++)
+        // Linear elements on their rule, indexed by element, the few curved slots stay unused
+        resdata.metric.assign(4 * num_element * n_quad_linear, 0.0);
+        #pragma omp parallel for
+        for (int i_linear_elem = 0; i_linear_elem < mesh.LinearElementIndex.size(); i_linear_elem++)
         {
-            // check if an element is converged
-            // Get the states in this element
-            ublas::matrix<double> u(Np, num_states, 0.0);
-            ublas::matrix<double> R(Np, num_states, 0.0);
-            ublas::matrix<double> u_1(Np, num_states, 0.0);
-            ublas::matrix<double> u_2(Np, num_states, 0.0);
-            ublas::matrix<double> u_new(Np, num_states, 0.0);
-            for (int ip = 0; ip < Np; ip++)
+            int ielem = mesh.LinearElementIndex[i_linear_elem];
+            const double* J = &resdata.jacobian_linear[4 * ielem];
+            for (int ig = 0; ig < n_quad_linear; ig++)
             {
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    u(ip, istate) = States_old(ielem * Np * num_states + ip * num_states + istate);
-                    u_1(ip, istate) = States_1(ielem * Np * num_states + ip * num_states + istate);
-                    u_2(ip, istate) = States_2(ielem * Np * num_states + ip * num_states + istate);
-                    u_new(ip, istate) = States_new(ielem * Np * num_states + ip * num_states + istate);
-                    R(ip, istate) = Residual_2(ielem * Np * num_states + ip * num_states + istate);
-                }
+                double w = resdata.quad_linear.w_quad(ig);
+                double* M = &resdata.metric[4 * (ielem * n_quad_linear + ig)];
+                M[0] = J[3] * w;  M[1] = -J[1] * w;
+                M[2] = -J[2] * w; M[3] = J[0] * w;
             }
-            ublas::matrix<double> invM_mul_R(Np, num_states, 0.0);
-            ublas::axpy_prod(invM(ielem), R, invM_mul_R, false);
-            u_new = (1.0 / 3) * u + (2.0 / 3) * u_2 - (2.0 / 3) * dt(ielem) * invM_mul_R;
-            // Apply the values of u_new to the long vector State_new
-            for (int ip = 0; ip < Np; ip++)
+        }
+        // Curved elements on their rule, indexed by the position in mesh.CurvedElementIndex
+        int num_curved_element = mesh.CurvedElementIndex.size();
+        resdata.metric_curved.resize(4 * num_curved_element * n_quad_curved);
+        #pragma omp parallel for
+        for (int icurved = 0; icurved < num_curved_element; icurved++)
+        {
+            for (int ig = 0; ig < n_quad_curved; ig++)
             {
-                for (int istate = 0; istate < num_states; istate++)
-                {
-                    States_new(ielem * Np * num_states + ip * num_states + istate) = u_new(ip, istate);
-                }
+                const double* J = &resdata.jacobian_curved[4 * (icurved * n_quad_curved + ig)];
+                double w = resdata.quad_curved.w_quad(ig);
+                double* M = &resdata.metric_curved[4 * (icurved * n_quad_curved + ig)];
+                M[0] = J[3] * w;  M[1] = -J[1] * w;
+                M[2] = -J[2] * w; M[3] = J[0] * w;
             }
         }
-        ublas::vector<double> Residual_new  = CalcResidual(mesh, param, resdata, States_new, dt_temp, p);
-        norm_residual = ublas::norm_inf(Residual_new);
-        if (norm_residual < eps)
-            converged = 1;
-        return  States_new;
     }
 
-    void PostProc(TriMesh mesh, ublas::vector<double> States, int p, ublas::vector<ublas::matrix<double> >& Nodes, ublas::vector<ublas::matrix<double> >& States_on_Nodes)
+    std::vector<std::array<double, 3> > StageCoefficients(const Param& param, double& step_length)
+    {
+        std::vector<std::array<double, 3> > stages;
+        if (strcasecmp(param.time_integrator.c_str(), "ssprk2") == 0)
+        {
+            // Ketcheson's low-storage SSPRK(m,2): m - 1 forward Euler stages of dt, then
+            // u_new = (u_0 + (m - 1) (u + dt L(u))) / m. The step advances (m - 1) dt, SSP coefficient m - 1
+            int m = param.rk_stages;
+            for (int istage = 1; istage < m - 1; istage++)
+            {
+                stages.push_back({{0.0, 1.0, 1.0}});
+            }
+            stages.push_back({{1.0 / m, (m - 1.0) / m, (m - 1.0) / m}});
+            step_length = m - 1.0;
+        }else
+        {
+            // Shu-Osher TVDRK3 in two registers
+            stages.push_back({{0.75, 0.25, 0.25}});
+            stages.push_back({{1.0 / 3, 2.0 / 3, 2.0 / 3}});
+            step_length = 1.0;
+        }
+        return stages;
+    }
+
+    void TimeMarching_SSPRK(const TriMesh& mesh, Param& param, const ResData& resdata, ublas::vector<double>& States, const mass::InvMass& inv_mass, int p,
+                            RKWorkspace& workspace, bool check_norm, int& converged, double& norm_residual)
+    {
+        int num_elements = mesh.num_element;
+        converged = 0;
+        // Size the registers on the first step, the residual of the initial states starts the first step
+        if (workspace.Residual.size() != States.size())
+        {
+            workspace.States_0.resize(States.size(), false);
+            workspace.Residual.resize(States.size(), false);
+            workspace.mws_tally.resize(num_elements, false);
+            workspace.dt.resize(num_elements, false);
+            workspace.dt_stage.resize(num_elements, false);
+            CalcResidual(mesh, param, resdata, States, workspace.dt, p, workspace.Residual, workspace.mws_tally);
+        }
+        // Second register, the states at the start of the step. The local time step of the first stage is used by all stages.
+        noalias(workspace.States_0) = States;
+        // Stage combinations, the first one uses the carried residual, the others are fused into the residual evaluation
+        kernels::StageUpdate stage = {0.0, 1.0, 1.0, &inv_mass, &workspace.dt, &workspace.States_0, &States};
+        kernels::ApplyStageUpdate(resdata, stage, workspace.Residual);
+        double step_length;
+        std::vector<std::array<double, 3> > stages = StageCoefficients(param, step_length);
+        for (int istage = 0; istage < stages.size(); istage++)
+        {
+            stage.a = stages[istage][0]; stage.b = stages[istage][1]; stage.c = stages[istage][2];
+            CalcResidual(mesh, param, resdata, States, workspace.dt_stage, p, workspace.Residual, workspace.mws_tally, &stage);
+        }
+        // First same as last: the residual of the new states is the first stage of the next step
+        CalcResidual(mesh, param, resdata, States, workspace.dt, p, workspace.Residual, workspace.mws_tally);
+        if (check_norm)
+        {
+            norm_residual = ublas::norm_inf(workspace.Residual);
+            if (norm_residual < param.eps)
+                converged = 1;
+        }
+    }
+
+    void PostProc(const TriMesh& mesh, const ublas::vector<double>& States, int p, ublas::vector<ublas::matrix<double> >& Nodes, ublas::vector<ublas::matrix<double> >& States_on_Nodes)
     {
         int num_elements = mesh.E.size();
         int Np = int((p + 1) * (p + 2) / 2);
         int num_states = 4;
-        ublas::vector<ublas::vector<double> > node_physical;
+        // Local index of the curved boundary edge of every element, found with one pass over B2E
+        std::vector<int> iloc_curved(num_elements, -1);
+        for (int iedge = 0; iedge < mesh.B2E.size(); iedge++)
+        {
+            if (mesh.B2E.group[iedge] + 1 == mesh.curved_group)
+            {
+                iloc_curved[mesh.B2E.elemL[iedge]] = mesh.B2E.locL[iedge];
+            }
+        }
         if (p == 0)
         {
             int Np_solution = 3;
+            #pragma omp parallel for
             for (int ielem = 0; ielem < num_elements; ielem++)
             {
-                node_physical = lagrange::MapReferenceToPhysical(mesh, ielem, 1, geometry::BumpFunction);
+                ublas::vector<ublas::vector<double> > node_physical = lagrange::MapReferenceToPhysical(mesh, ielem, 1, geometry::BumpFunction, iloc_curved[ielem]);
                 for (int ip = 0; ip < Np_solution; ip++)
                 {
                     for (int i = 0; i < 2; i++)
@@ -648,9 +500,10 @@ namespace solver{
         }
         else
         {
+            #pragma omp parallel for
             for (int ielem = 0; ielem < num_elements; ielem++)
             {
-                node_physical = lagrange::MapReferenceToPhysical(mesh, ielem, p, geometry::BumpFunction);
+                ublas::vector<ublas::vector<double> > node_physical = lagrange::MapReferenceToPhysical(mesh, ielem, p, geometry::BumpFunction, iloc_curved[ielem]);
                 for (int ip = 0; ip < Np; ip++)
                 {
                     for (int i = 0; i < 2; i++)
@@ -666,8 +519,8 @@ namespace solver{
         }
     }
 
-    void CalcScalarOutputs(TriMesh mesh, ResData resdata, ublas::vector<ublas::matrix<double> >& States_on_Nodes, ublas::vector<ublas::matrix<double> >& Nodes,
-                            Param param, double& err_entropy, double& coeff_lift, double& coeff_drag, std::vector<std::vector<double> >& p_coeff_dist)
+    void CalcScalarOutputs(const TriMesh& mesh, const ResData& resdata, ublas::vector<ublas::matrix<double> >& States_on_Nodes, ublas::vector<ublas::matrix<double> >& Nodes,
+                            const Param& param, double& err_entropy, double& coeff_lift, double& coeff_drag, std::vector<std::vector<double> >& p_coeff_dist)
     {
         // The constants
         double p_inf = param.p_inf;
@@ -706,29 +559,33 @@ namespace solver{
         for (int i_linear_elem = 0; i_linear_elem < mesh.LinearElementIndex.size(); i_linear_elem++)
         {
             int ielem = mesh.LinearElementIndex[i_linear_elem];
-            ublas::matrix<double> jacobian = resdata.jacobian_in_linear_elements(ielem);
-            double det_jacobian = jacobian(0, 0) * jacobian(1, 1) - jacobian(0, 1) * jacobian(1, 0);
+            const double* jacobian = &resdata.jacobian_linear[4 * ielem];
+            double det_jacobian = jacobian[0] * jacobian[3] - jacobian[1] * jacobian[2];
             total_area += det_jacobian;
-            for (int ig = 0; ig < resdata.n_quad_2d; ig++) // integrate on quadrature points
+            for (int ig = 0; ig < resdata.quad_linear.n_quad; ig++) // integrate on quadrature points
             {
                 for (int ip = 0; ip < Np; ip++)
                 {
-                    err_entropy += resdata.Phi[ig][ip] * rel_s2_on_nodes(ielem)(ip, 0) * resdata.w_quad_2d(ig) * det_jacobian;
+                    err_entropy += resdata.quad_linear.Phi[ig][ip] * rel_s2_on_nodes(ielem)(ip, 0) * resdata.quad_linear.w_quad(ig) * det_jacobian;
                 }
             }
         }
-        // curved elements
+        // curved elements, the jacobians from the geometry nodes as resdata.jacobian_curved may have been released
+        std::vector<double> nodes (2 * resdata.Nq);
         for (int i_curved_elem = 0; i_curved_elem < mesh.CurvedElementIndex.size(); i_curved_elem++)
         {
             int ielem = mesh.CurvedElementIndex[i_curved_elem];
-            for (int ig = 0; ig < resdata.n_quad_2d; ig++)
+            const QuadRule2D& rule = resdata.quad_curved;
+            GatherElementNodes(mesh, ielem, resdata.Nq, &nodes[0]);
+            for (int ig = 0; ig < rule.n_quad; ig++)
             {
-                ublas::matrix<double> jacobian = resdata.jacobian_in_curved_elements(ielem, ig);
-                double det_jacobian = jacobian(0, 0) * jacobian(1, 1) - jacobian(0, 1) * jacobian(1, 0);
-                total_area += resdata.w_quad_2d(ig) * det_jacobian;
+                double jacobian[4];
+                CalcCurvedJacobian(resdata, &nodes[0], ig, jacobian);
+                double det_jacobian = jacobian[0] * jacobian[3] - jacobian[1] * jacobian[2];
+                total_area += rule.w_quad(ig) * det_jacobian;
                 for (int ip = 0; ip < Np; ip++)
                 {
-                    err_entropy += resdata.Phi[ig][ip] * rel_s2_on_nodes(ielem)(ip, 0) * resdata.w_quad_2d(ig) * det_jacobian;
+                    err_entropy += rule.Phi[ig][ip] * rel_s2_on_nodes(ielem)(ip, 0) * rule.w_quad(ig) * det_jacobian;
                 }
             }
         }
@@ -740,53 +597,8 @@ namespace solver{
         for (int iedge_curved = 0; iedge_curved < mesh.CurvedEdgeIndex.size(); iedge_curved++)
         {
             int iedge = mesh.CurvedEdgeIndex[iedge_curved];
-            int ielemL = mesh.B2E[iedge][0] - 1;
-            int ilocL = mesh.B2E[iedge][1] - 1;
-            // Get the geometry points on the edge
-            ublas::vector<ublas::vector<double> > edge_coord = geometry::GetEdgeCoordinates(mesh, iedge);
-            ublas::vector<int> edge_coord_ind = geometry::GetEdgeCoordinatesIndex(mesh, iedge);
-            ublas::vector<ublas::vector<double> > norm_on_quad_curved(resdata.n_quad_1d, ublas::vector<double> (2));
-            double Nq = resdata.Nq;
-            int q = int((sqrt(1 + 8.0 * Nq) - 3) / 2);
-            ublas::vector<double> quad_x_total(resdata.n_quad_1d, 0.0);
-            for (int ig = 0; ig < resdata.n_quad_1d; ig++)
-            {
-                ublas::vector<double> tangent(2, 0.0);
-                double quad_x = 0.0;
-                for (int iq = 0; iq < q + 1; iq++)
-                {
-                    int local_lagrange_ind = edge_coord_ind(iq);
-                    double deriv_along_edge = 0.0;
-                    switch (ilocL)
-                    {
-                        case 0:
-                            tangent(0) += - edge_coord(iq)(0) * resdata.GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0]
-                                        + edge_coord(iq)(0) * resdata.GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
-                            tangent(1) += - edge_coord(iq)(1) * resdata.GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0]
-                                        + edge_coord(iq)(1) * resdata.GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
-                            quad_x += - edge_coord(iq)(0) * resdata.Phi_1D_Curved[ilocL][ig][local_lagrange_ind];
-                            break;
-                        case 1:
-                            deriv_along_edge = - resdata.GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][1];
-                            tangent(0) += edge_coord(iq)(0) * deriv_along_edge;
-                            tangent(1) += edge_coord(iq)(1) * deriv_along_edge;
-                            quad_x += - edge_coord(iq)(0) * resdata.Phi_1D_Curved[ilocL][ig][local_lagrange_ind];
-                            break;
-                        case 2:
-                            deriv_along_edge = resdata.GPhi_1D_Curved[ilocL][ig][local_lagrange_ind][0];
-                            tangent(0) += edge_coord(iq)(0) * deriv_along_edge;
-                            tangent(1) += edge_coord(iq)(1) * deriv_along_edge;
-                            quad_x += - edge_coord(iq)(0) * resdata.Phi_1D_Curved[ilocL][ig][local_lagrange_ind];
-                            break;
-                        default:
-                            break;
-                    }
-                }
-                norm_on_quad_curved(ig)(0) = tangent(1);
-                norm_on_quad_curved(ig)(1) = -1.0 * tangent(0);
-                quad_x_total(ig) = quad_x;
-            }
-
+            int ielemL = mesh.B2E.elemL[iedge];
+            int ilocL = mesh.B2E.locL[iedge];
             // Now do the integration using 1d quad points
             for (int ig = 0; ig < resdata.n_quad_1d; ig++)
             {
@@ -796,12 +608,13 @@ namespace solver{
                 {
                     p_quad += resdata.Phi_1D[ilocL][ig][ipi] * p_on_nodes(ielemL)(ipi, 0);
                 }
-                double jacobian_edge = ublas::norm_2(norm_on_quad_curved(ig));
-                ublas::vector<double> norm_vec = norm_on_quad_curved(ig) / jacobian_edge;
-                coeff_lift += (p_quad - p_inf) * norm_vec(1) * jacobian_edge * resdata.w_quad_1d(ig);
-                coeff_drag += (p_quad - p_inf) * norm_vec(0) * jacobian_edge * resdata.w_quad_1d(ig);
+                int k = iedge_curved * resdata.n_quad_1d + ig;
+                double jacobian_edge = resdata.curved_edge_jacobian[k];
+                const double* norm_vec = &resdata.curved_edge_normal[2 * k];
+                coeff_lift += (p_quad - p_inf) * norm_vec[1] * jacobian_edge * resdata.w_quad_1d(ig);
+                coeff_drag += (p_quad - p_inf) * norm_vec[0] * jacobian_edge * resdata.w_quad_1d(ig);
                 double p_coeff = (p_quad - p_inf) / (0.5 * gamma * p_inf * m_inf * m_inf);
-                std::vector<double> p_coeff_on_node = {quad_x_total(ig), p_coeff};
+                std::vector<double> p_coeff_on_node = {resdata.curved_edge_x[k], p_coeff};
                 p_coeff_dist.push_back(p_coeff_on_node);
             }
         }
@@ -18,9 +18,13 @@ namespace utils
         return k - 1; // return the index which is zero based
     }
 
-    std::vector<int> GetVertexIndex(std::vector<int> &element)
+    std::vector<int> GetVertexIndex(const std::vector<int> &element)
+    {
+        return GetVertexIndex(int(element.size()));
+    }
+
+    std::vector<int> GetVertexIndex(int num_node_in_element)
     {
-        int num_node_in_element = element.size();
         // calculate the order of bases based on the number of nondes in the element
         int num_order = int((sqrt(8 * num_node_in_element + 1) - 3) / 2);
         std::vector<int> vertex_index(3);